@@ -6,12 +6,39 @@
  */
 
 //! Standard C++ imports.
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
 
 //! Importing the FCPP library.
 #include "lib/fcpp.hpp"
+//! Importing the CSR capacities.
+#include "lib/topology.hpp"
+//! Importing the reference solver.
+#include "lib/openmp.hpp"
+//! Importing the scenarios of events.
+#include "lib/scenario.hpp"
+//! Importing the execution trace.
+#include "lib/trace.hpp"
+//! Importing the checkpoints of the algorithm state.
+#include "lib/checkpoint.hpp"
+//! Importing the simulation parameters.
+#include "lib/parameters.hpp"
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
@@ -20,10 +47,70 @@ namespace fcpp {
 
 //! @brief Dimensionality of the space.
 constexpr size_t dim = 2;
-//! @brief The size of the simulation area.
-constexpr size_t area_size = 500;
-//! @brief Convergence time.
-constexpr size_t time_step = 200;
+//! @brief The size of the simulation area (by default).
+constexpr size_t area_size = default_area_side;
+//! @brief Convergence time (the length of phases by default, and the longest skip of rounds).
+constexpr size_t time_step = default_phase_time;
+//! @brief Number of changes of sources and sinks (each lasting time_step).
+constexpr size_t phase_number = default_phase_number;
+//! @brief Maximum slowdown of rounds for quiescent devices (adaptive schedule).
+constexpr size_t max_backoff = 8;
+//! @brief Number of rounds between liftings of heights to the residual distance from sinks (global relabel).
+constexpr int relabel_period = 10;
+//! @brief Whether rounds are synchronous (at every half period), or asynchronous if built with PUSH_RELABEL_ASYNC.
+#ifdef PUSH_RELABEL_ASYNC
+constexpr bool sync_rounds = false;
+#else
+constexpr bool sync_rounds = true;
+#endif
+
+//! @brief Namespace containing the compile-time selection of algorithm variants.
+namespace variants {
+    //! @brief Implementations of a round of the algorithm on the neighbourhood.
+    enum class kernel {
+        reference,  //!< Field operations, one pass each.
+        fused,      //!< Few passes over aligned neighbour arrays.
+        checked     //!< Fused, aborting if different from the reference one.
+    };
+
+    //! @brief Variant flags (all disabled by default).
+    template <bool adaptive_rounds = false, bool global_relabel = false, bool proportional_push = false, bool stop_early = false, kernel round = kernel::reference, bool count_events = false, bool estimate_messages = false>
+    struct flags {
+        //! @brief Whether rounds of quiescent nodes are slowed down.
+        static constexpr bool adaptive = adaptive_rounds;
+        //! @brief Whether heights are periodically lifted to the residual distance from sinks.
+        static constexpr bool relabel = global_relabel;
+        //! @brief Whether excess is spread over all lower neighbours in a round.
+        static constexpr bool multi_push = proportional_push;
+        //! @brief Whether convergence is tracked, and rounds skipped once every node is quiescent (sequential simulations only).
+        static constexpr bool early_stop = stop_early;
+        //! @brief The implementation of a round on the neighbourhood.
+        static constexpr kernel round_kernel = round;
+        //! @brief Whether relabels, pushes, rollbacks, truncations and height clamps are counted.
+        static constexpr bool counters = count_events;
+        //! @brief Whether the size of exports in a compact delta encoding is estimated (exports sent are unchanged).
+        static constexpr bool message_estimate = estimate_messages;
+    };
+    //! @brief The algorithm as originally designed.
+    using standard = flags<>;
+    //! @brief Rounds slowed down for quiescent nodes.
+    using adaptive = flags<true>;
+    //! @brief Heights periodically lifted to the residual distance from sinks.
+    using global_relabel = flags<false, true>;
+    //! @brief Excess spread over all lower neighbours proportionally to residual capacity.
+    using multi_push = flags<false, false, true>;
+    //! @brief Rounds computed by the fused kernel.
+    using fused = flags<false, false, false, false, kernel::fused>;
+    //! @brief Rounds computed by the fused kernel, checked against the reference one.
+    using fused_checked = flags<false, false, false, false, kernel::checked>;
+    //! @brief The algorithm as originally designed, with counters of its mechanisms.
+    using counters = flags<false, false, false, false, kernel::reference, true>;
+    //! @brief The algorithm as originally designed, estimating the size of its exports in a compact encoding.
+    using messages = flags<false, false, false, false, kernel::reference, false, true>;
+    //! @brief The variant V with convergence tracking and early stop.
+    template <typename V>
+    using early_stop = flags<V::adaptive, V::relabel, V::multi_push, true, V::round_kernel, V::counters, V::message_estimate>;
+}
 
 //! @brief Namespace containing the libraries of coordination routines.
 namespace coordination {
@@ -53,11 +140,61 @@ namespace tags {
     struct excess_flow {};
     //! @brief Node heights
     struct node_height {};
+    //! @brief Estimated bytes of the export of a node in the last round, if delta-encoded compactly
+    struct message_bytes_estimate {};
+    //! @brief Estimated bytes of the export of a node in the last round, with the previous layout
+    struct raw_message_bytes_estimate {};
+    //! @brief Number of rounds executed by a node
+    struct round_count {};
+    //! @brief Relabels of a node in the last round
+    struct relabel_count {};
+    //! @brief Neighbours a node pushed new flow to in the last round
+    struct push_count {};
+    //! @brief Flows rolled back with priority 2 by the handshake of a node in the last round
+    struct rollback_count {};
+    //! @brief Outgoing flows truncated by excess limiting at a node in the last round
+    struct truncation_count {};
+    //! @brief Heights lowered to a neighbour's by the final clamp of a node in the last round
+    struct clamp_count {};
+    //! @brief Time from the last change of sources and sinks until the sink flow last became ideal
+    struct convergence_time {};
+    //! @brief History of the convergence times for every change of sources and sinks
+    struct convergence_history {};
+    //! @brief Index of a state of the network (in convergence plots)
+    struct network_state {};
+    //! @brief Total outward flow at sinks
+    struct total_sink_flow {};
+    //! @brief Last time the total outward flow at sinks changed
+    struct last_flow_change {};
+    //! @brief Number of quiescent nodes
+    struct quiescent_nodes {};
 
     //! @brief Capacity of edges
     struct edge_capacities {};
+    //! @brief Capacities of edges of all nodes in CSR form, shared read-only (if given)
+    struct capacity_csr {};
+    //! @brief Flows and heights of all nodes at the end of the first phase, from the reference solver (if given)
+    struct reference_state {};
+    //! @brief The states of the network over time (sources, sinks and capacities), shared read-only
+    struct network_scenario {};
+    //! @brief Collector of the state of all nodes at a given time, to be saved as a checkpoint (if given)
+    struct checkpoint_out {};
+    //! @brief State of all nodes at a given time to resume from, skipping the rounds before it (if given)
+    struct checkpoint_in {};
+    //! @brief Time before which rounds are skipped (of the checkpoint resumed from, or the end of the first state with a warm start)
+    struct start_time {};
+    //! @brief Total number of rounds skipped before the start time
+    struct skipped_rounds {};
     //! @brief Total number of nodes
     struct node_number {};
+    //! @brief When rounds and logs end
+    struct end_time {};
+    //! @brief Mean time between rounds
+    struct round_period {};
+    //! @brief Deviation of the time between rounds (asynchronous rounds only)
+    struct round_deviation {};
+    //! @brief Side of the square area where devices are dispersed (graphical simulations only)
+    struct area_side {};
     //! @brief ID of the testcase
     struct test_id {};
 }
@@ -66,125 +203,615 @@ namespace tags {
 FUN void disperser(ARGS, std::false_type) {}
 //! @brief Function for moving devices according to the network topology.
 FUN void disperser(ARGS, std::true_type) { CODE
-    vec<2> v = neighbour_elastic_force(CALL, 0.2*area_size, 0.03) + point_elastic_force(CALL, make_vec(area_size,area_size)/2, 0, 0.005);
+    real_t side = node.net.storage(tags::area_side{});
+    vec<2> v = neighbour_elastic_force(CALL, 0.2*side, 0.03) + point_elastic_force(CALL, make_vec(side,side)/2, 0, 0.005);
     if (isnan(v[0]) or isnan(v[1])) v = make_vec(0,0);
     node.velocity() = v;
 }
 //! @brief Export types used by the disperser function.
 FUN_EXPORT disperser_t = export_list<neighbour_elastic_force_t, point_elastic_force_t>;
 
-//! @brief Aggregate Push-Relabel algorithm, calculating excess flow and height of nodes.
-FUN tuple<long long, int> aggregate_push_relabel(ARGS, bool is_source, bool is_sink, field<long long> capacity, int node_num) { CODE
-    long long e_flow = 0;
-    int height = 0;
-    tuple<field<long long>, int, int> init(0, 0, 0);
+//! @brief Largest absolute flow that can be packed with a priority without overflowing.
+constexpr long long max_packed_flow = std::numeric_limits<long long>::max() / 4;
+//! @brief Packs a flow and a priority (from 0 to 2) into a single value, the priority taking the 2 lowest bits.
+inline long long pack_flow(long long flow, int priority) {
+    assert(flow >= -max_packed_flow and flow <= max_packed_flow and priority >= 0 and priority < 4);
+    return flow * 4 + priority;
+}
+//! @brief Extracts the priority from a packed flow.
+inline int unpack_priority(long long packed) {
+    return static_cast<int>((packed % 4 + 4) % 4);
+}
+//! @brief Extracts the flow from a packed flow.
+inline long long unpack_flow(long long packed) {
+    return (packed - unpack_priority(packed)) / 4;
+}
 
-    nbr(CALL, init, [&](field<tuple<long long, int, int>> flow_height){
-        field<long long> new_flow = 0;
+//! @brief Number of bytes of a value in unsigned LEB128 (varint) encoding.
+inline size_t varint_size(unsigned long long x) {
+    size_t n = 1;
+    while (x >= 0x80) {
+        x >>= 7;
+        ++n;
+    }
+    return n;
+}
+//! @brief Number of bytes of a signed value in zig-zag varint encoding.
+inline size_t zigzag_size(long long x) {
+    return varint_size((static_cast<unsigned long long>(x) << 1) ^ static_cast<unsigned long long>(x >> 63));
+}
 
-        field<long long> flow = -get<0>(flow_height);
-        field<int> nbr_height = get<1>(flow_height);
-        field<int> nbr_priority = get<2>(flow_height);
+//! @brief Function leaving heights to local relabelling.
+FUN int global_relabel(ARGS, bool, field<long long> const&, field<long long> const&, int height, int, std::false_type) {
+    return height;
+}
+//! @brief Function computing the hop distance to the nearest sink over residual arcs, and periodically lifting the height to it.
+FUN int global_relabel(ARGS, bool is_sink, field<long long> const& capacity, field<long long> const& packed, int height, int node_num, std::true_type) { CODE
+    using namespace tags;
+    // distances are tagged with the state of the network, and the ones of other states count as zero: after a change,
+    // they grow back from below to the new ones, instead of lifting heights to stale distances
+    int state = node.net.storage(network_scenario{})->at(node.current_time());
+    int distance = get<1>(nbr(CALL, make_tuple(state, 0), [&](field<tuple<int, int>> const& nbr_distance){
+        if (is_sink) return make_tuple(state, 0);
+        field<int> reachable = map_hood([&](long long c, long long p, tuple<int, int> d, device_t uid){
+            return c > unpack_flow(p) and uid != node.uid ? (get<0>(d) == state ? get<1>(d) : 0) : node_num;
+        }, capacity, packed, nbr_distance, nbr_uid(CALL));
+        return make_tuple(state, min(min_hood(CALL, reachable) + 1, node_num));
+    }));
+    int round = old(CALL, 0, [](int r){
+        return r + 1;
+    });
+    return round % relabel_period == 0 ? max(height, distance) : height;
+}
+//! @brief Export types used by the global_relabel function.
+FUN_EXPORT global_relabel_t = export_list<tuple<int, int>, int>;
 
-        height = get<1>(self(CALL, flow_height));
-        field<bool> neigh_is_source = nbr(CALL, is_source);
-        
-        tuple<field<long long>, field<int>> o_flow(flow, nbr_priority);
-
-        o_flow = old(CALL, o_flow, [&](field<tuple<long long, int>> old_values){
-            field<long long> old_flow = get<0>(old_values);
-            field<int> old_priority = get<1>(old_values);
-
-            field<tuple<long long, int>> temp = map_hood([&](long long f, long long of, int priority, int h, int op, int uids){
-                if(priority == op and op == 2 and f != of){
-                    if(node.uid < uids){
-                        return make_tuple(of, 2);
-                    }
-                    return make_tuple(f, 2);
-                }
-
-                if(f != of and height + 1 != h and priority == 1){
-                    return make_tuple(of, 2);
-                } else{
-                    return make_tuple(f, 0);
-                }
-            }, flow, old_flow, nbr_priority, nbr_height, old_priority, nbr_uid(CALL));
-
-            flow = get<0>(temp);
-            nbr_priority = get<1>(temp);
-
-            if (is_sink) {
-                height = 0;
-                flow = mux(flow > 0, 0ll, flow);
-            }
-            if (is_source) {
-                height = node_num;
-                flow = mux(nbr_height < height, capacity, mux(flow < 0, 0ll, flow));
+//! @brief Function pushing excess flow to the lowest neighbour only.
+FUN field<long long> push_flow(ARGS, field<long long> const& res_capacity, field<int> const&, int height, tuple<int, int> min_height, long long e_flow, std::false_type) {
+    return mux(get<1>(min_height) == nbr_uid(CALL) and height >= get<0>(min_height) + 1, min(res_capacity, e_flow), 0ll);
+}
+//! @brief Function spreading excess flow over all lower neighbours, proportionally to their residual capacity.
+FUN field<long long> push_flow(ARGS, field<long long> const& res_capacity, field<int> const& nbr_height, int height, tuple<int, int>, long long e_flow, std::true_type) {
+    field<long long> admissible = mux(res_capacity > 0 and nbr_height < height and nbr_uid(CALL) != node.uid, res_capacity, 0ll);
+    long long total = sum_hood(CALL, admissible, 0ll);
+    if (total <= e_flow) return admissible;
+    field<long long> new_flow = map_hood([&](long long r){
+        return static_cast<long long>(static_cast<__int128>(r) * e_flow / total);
+    }, admissible);
+    // the rounding remainder goes to neighbours in order, up to their residual capacity
+    long long rest = e_flow - sum_hood(CALL, new_flow, 0ll);
+    return map_hood([&](long long f, long long r){
+        long long d = min(rest, r - f);
+        rest -= d;
+        return f + d;
+    }, new_flow, admissible);
+}
+
+//! @brief Counters of the mechanisms of the algorithm in a round, over neighbours (compiled out if not enabled).
+template <bool count_events>
+struct round_counters {
+    //! @brief Whether events are counted.
+    static constexpr bool enabled = count_events;
+
+    //! @brief Adds to a counter, if enabled.
+    void add(int& counter, int n = 1) {
+        if constexpr (enabled) counter += n;
+    }
+
+    int relabels = 0, pushes = 0, rollbacks = 0, truncations = 0, clamps = 0;
+};
+
+//! @brief Reference round of push-relabel on the neighbourhood, returning packed flows towards neighbours (and updating height and excess).
+template <typename node_t, typename M, typename K>
+field<long long> push_relabel_step(node_t& node, trace_t call_point, field<tuple<long long, int>> const& flow_height, field<long long> const& old_values, field<long long> const& capacity, bool is_source, bool is_sink, int node_num, int& height, long long& e_flow, K& count, M multi_push, std::integral_constant<variants::kernel, variants::kernel::reference>) {
+    field<long long> new_flow = 0;
+    field<long long> flow = -map_hood(unpack_flow, get<0>(flow_height));
+    field<int> nbr_height = get<1>(flow_height);
+    field<int> nbr_priority = map_hood(unpack_priority, get<0>(flow_height));
+
+    field<tuple<long long, int>> temp = map_hood([&](long long f, long long old_packed, int priority, int h, int uids){
+        long long of = unpack_flow(old_packed);
+        int op = unpack_priority(old_packed);
+        if(priority == op and op == 2 and f != of){
+            if(node.uid < uids){
+                return make_tuple(of, 2);
             }
+            return make_tuple(f, 2);
+        }
+
+        if(f != of and height + 1 != h and priority == 1){
+            return make_tuple(of, 2);
+        } else{
+            return make_tuple(f, 0);
+        }
+    }, flow, old_values, nbr_priority, nbr_height, nbr_uid(CALL));
+
+    flow = get<0>(temp);
+    nbr_priority = get<1>(temp);
+    if constexpr (K::enabled) count.add(count.rollbacks, sum_hood(CALL, mux(nbr_priority == 2, 1, 0), 0));
 
-            flow = mux(flow > capacity, capacity, flow);
-            e_flow = -sum_hood(CALL, flow, 0);
-
-            // if a node is giving away more flow than it receives, stop giving excess (variant to try: reduce outgoing edges proportionally)
-            if (not is_source and e_flow < 0) {
-                flow = map_hood([&](long long f, int priority){
-                    if (f > 0) {
-                        long long r = min(-e_flow, f);
-                        f -= r;
-                        e_flow -= r;
-                    }
-                    return f;
-                }, flow, nbr_priority);
+    if (is_sink) {
+        height = 0;
+        flow = map_hood([](long long f){
+            return min(f, 0ll);
+        }, flow);
+    }
+    if (is_source) {
+        height = node_num;
+        flow = map_hood([&](long long f, long long c, int h){
+            return h < height ? c : max(f, 0ll);
+        }, flow, capacity, nbr_height);
+    }
+
+    flow = map_hood([](long long f, long long c){
+        return min(f, c);
+    }, flow, capacity);
+    e_flow = -sum_hood(CALL, flow, 0);
+
+    // if a node is giving away more flow than it receives, stop giving excess (variant to try: reduce outgoing edges proportionally)
+    if (not is_source and e_flow < 0) {
+        field<long long> untruncated = flow;
+        flow = map_hood([&](long long f, int priority){
+            if (f > 0) {
+                long long r = min(-e_flow, f);
+                f -= r;
+                e_flow -= r;
             }
-            
-            field<long long> res_capacity = capacity - flow;
+            return f;
+        }, flow, nbr_priority);
+        if constexpr (K::enabled) count.add(count.truncations, sum_hood(CALL, mux(flow < untruncated, 1, 0), 0));
+    }
 
-            field<int> neighs = nbr_uid(CALL);
-            tuple<int, int> min_height = min_hood(CALL, mux(res_capacity > 0 and neighs != node.uid, make_tuple(nbr_height, neighs), make_tuple(INT_MAX, INT_MAX)));
+    field<long long> res_capacity = capacity - flow;
+
+    field<int> neighs = nbr_uid(CALL);
+    tuple<int, int> min_height = min_hood(CALL, mux(res_capacity > 0 and neighs != node.uid, make_tuple(nbr_height, neighs), make_tuple(INT_MAX, INT_MAX)));
+
+    if (get<0>(min_height) >= height and e_flow > 0 and not is_source and not is_sink) {
+        assert(min_height != make_tuple(INT_MAX, INT_MAX));
+        height = get<0>(min_height) + 1; // Relabel
+        count.add(count.relabels);
+    }
+
+    if (not is_source and not is_sink and e_flow > 0){
+        new_flow = push_flow(CALL, res_capacity, nbr_height, height, min_height, e_flow, multi_push);
+        nbr_priority = mux(new_flow > 0, 1, nbr_priority);
+        if constexpr (K::enabled) count.add(count.pushes, sum_hood(CALL, mux(new_flow > 0, 1, 0), 0));
+    }
+
+    int clamped = min_hood(CALL, mux(res_capacity > 0 and nbr_height + 1 < height, nbr_height, height));
+    count.add(count.clamps, clamped < height);
+    height = clamped;
+    return map_hood(pack_flow, flow + new_flow, nbr_priority);
+}
+
+//! @brief Scratch arrays of the fused kernel, aligned on the neighbourhood (default value first) and reused across rounds.
+struct fused_scratch {
+    std::vector<device_t> ids, merged;
+    std::vector<device_t> uid;
+    std::vector<char> neighbour;
+    std::vector<int> height, priority;
+    std::vector<long long> packed, old_packed, capacity, flow, residual, admissible, new_flow, result;
+};
+
+//! @brief Merges the ids of a field into a sorted set of ids.
+template <typename T>
+void merge_ids(fused_scratch& s, field<T> const& f) {
+    std::vector<device_t> const& other = details::get_ids(f);
+    s.merged.clear();
+    std::set_union(s.ids.begin(), s.ids.end(), other.begin(), other.end(), std::back_inserter(s.merged));
+    swap(s.ids, s.merged);
+}
 
-            if (get<0>(min_height) >= height and e_flow > 0 and not is_source and not is_sink) {
-                assert(min_height != make_tuple(INT_MAX, INT_MAX));
-                height = get<0>(min_height) + 1; // Relabel
+//! @brief Writes the values of a field on a sorted set of ids (default value first), transformed by an operator.
+template <typename T, typename R, typename O>
+void align_field(std::vector<device_t> const& ids, field<T> const& f, std::vector<R>& out, O&& op) {
+    std::vector<device_t> const& f_ids = details::get_ids(f);
+    auto const& f_vals = details::get_vals(f);
+    out.resize(ids.size() + 1);
+    out[0] = op(f_vals[0]);
+    for (size_t i = 0, j = 0; i < ids.size(); ++i) {
+        while (j < f_ids.size() and f_ids[j] < ids[i]) ++j;
+        out[i+1] = op(j < f_ids.size() and f_ids[j] == ids[i] ? f_vals[j+1] : f_vals[0]);
+    }
+}
+
+//! @brief Round of push-relabel computing the same result as the reference one in a few passes over aligned neighbour arrays.
+template <typename node_t, typename M, typename K>
+field<long long> push_relabel_step(node_t& node, trace_t call_point, field<tuple<long long, int>> const& flow_height, field<long long> const& old_values, field<long long> const& capacity, bool is_source, bool is_sink, int node_num, int& height, long long& e_flow, K& count, M, std::integral_constant<variants::kernel, variants::kernel::fused>) {
+    thread_local fused_scratch s;
+    field<device_t> uids = nbr_uid(CALL);
+    s.ids.clear();
+    merge_ids(s, flow_height);
+    merge_ids(s, old_values);
+    merge_ids(s, capacity);
+    merge_ids(s, uids);
+    auto identity = [](auto x){ return x; };
+    align_field(s.ids, flow_height, s.packed, [](tuple<long long, int> const& t){ return get<0>(t); });
+    align_field(s.ids, flow_height, s.height, [](tuple<long long, int> const& t){ return get<1>(t); });
+    align_field(s.ids, old_values, s.old_packed, identity);
+    align_field(s.ids, capacity, s.capacity, identity);
+    align_field(s.ids, uids, s.uid, identity);
+    // folds range over neighbours only (the ids of nbr_uid), never on the default value
+    std::vector<device_t> const& nbr_ids = details::get_ids(uids);
+    s.neighbour.assign(s.ids.size() + 1, false);
+    for (size_t i = 0, j = 0; i < s.ids.size(); ++i) {
+        while (j < nbr_ids.size() and nbr_ids[j] < s.ids[i]) ++j;
+        s.neighbour[i+1] = j < nbr_ids.size() and nbr_ids[j] == s.ids[i];
+    }
+    size_t n = s.ids.size() + 1;
+    s.flow.resize(n);
+    s.priority.resize(n);
+    s.residual.resize(n);
+    s.new_flow.assign(n, 0);
+    s.result.resize(n);
+
+    // priority handshake and clamps, summing the excess
+    int old_height = height;
+    if (is_sink) height = 0;
+    if (is_source) height = node_num;
+    long long sum = 0;
+    for (size_t e = 0; e < n; ++e) {
+        long long f = -unpack_flow(s.packed[e]);
+        int priority = unpack_priority(s.packed[e]);
+        long long of = unpack_flow(s.old_packed[e]);
+        int op = unpack_priority(s.old_packed[e]);
+        if (priority == op and op == 2 and f != of) {
+            if (node.uid >= s.uid[e]) of = f;
+            f = of;
+            priority = 2;
+        } else if (f != of and old_height + 1 != s.height[e] and priority == 1) {
+            f = of;
+            priority = 2;
+        } else priority = 0;
+        if (is_sink) f = min(f, 0ll);
+        if (is_source) f = s.height[e] < height ? s.capacity[e] : max(f, 0ll);
+        f = min(f, s.capacity[e]);
+        s.flow[e] = f;
+        s.priority[e] = priority;
+        if (s.neighbour[e] and s.uid[e] != node.uid) {
+            sum += f;
+            count.add(count.rollbacks, priority == 2);
+        }
+    }
+    e_flow = -sum;
+
+    // excess limiting (in map_hood order, default value first) and lowest residual neighbour
+    bool limit = not is_source and e_flow < 0;
+    tuple<int, int> min_height(INT_MAX, INT_MAX);
+    for (size_t e = 0; e < n; ++e) {
+        if (limit and s.flow[e] > 0) {
+            long long r = min(-e_flow, s.flow[e]);
+            s.flow[e] -= r;
+            e_flow -= r;
+            if (s.neighbour[e] and s.uid[e] != node.uid) count.add(count.truncations, r > 0);
+        }
+        s.residual[e] = s.capacity[e] - s.flow[e];
+        if (s.neighbour[e] and s.residual[e] > 0 and s.uid[e] != node.uid)
+            min_height = min(min_height, make_tuple(s.height[e], int(s.uid[e])));
+    }
+    if (get<0>(min_height) >= height and e_flow > 0 and not is_source and not is_sink) {
+        assert(min_height != make_tuple(INT_MAX, INT_MAX));
+        height = get<0>(min_height) + 1; // Relabel
+        count.add(count.relabels);
+    }
+
+    // pushes, height clamp and packing
+    bool push = not is_source and not is_sink and e_flow > 0;
+    if (push and M::value) {
+        long long total = 0;
+        s.admissible.resize(n);
+        for (size_t e = 0; e < n; ++e) {
+            s.admissible[e] = s.residual[e] > 0 and s.height[e] < height and s.uid[e] != node.uid ? s.residual[e] : 0;
+            if (s.neighbour[e] and s.uid[e] != node.uid) total += s.admissible[e];
+        }
+        if (total <= e_flow) s.new_flow = s.admissible;
+        else {
+            long long pushed = 0;
+            for (size_t e = 0; e < n; ++e) {
+                s.new_flow[e] = static_cast<long long>(static_cast<__int128>(s.admissible[e]) * e_flow / total);
+                if (s.neighbour[e] and s.uid[e] != node.uid) pushed += s.new_flow[e];
             }
-            
-            if (not is_source and not is_sink and e_flow > 0){
-                new_flow = mux(get<1>(min_height) == neighs and height >= get<0>(min_height) + 1, min(res_capacity, e_flow), 0ll);
-                nbr_priority = mux(new_flow > 0, 1, nbr_priority);
+            long long rest = e_flow - pushed;
+            for (size_t e = 0; e < n; ++e) {
+                long long d = min(rest, s.admissible[e] - s.new_flow[e]);
+                rest -= d;
+                s.new_flow[e] += d;
             }
+        }
+    }
+    int new_height = height;
+    for (size_t e = 0; e < n; ++e) {
+        if (push and not M::value and s.uid[e] == get<1>(min_height) and height >= get<0>(min_height) + 1)
+            s.new_flow[e] = min(s.residual[e], e_flow);
+        if (push and s.new_flow[e] > 0) {
+            s.priority[e] = 1;
+            if (s.neighbour[e] and s.uid[e] != node.uid) count.add(count.pushes);
+        }
+        if (s.neighbour[e] and s.residual[e] > 0 and s.height[e] + 1 < height)
+            new_height = min(new_height, s.height[e]);
+        s.result[e] = pack_flow(s.flow[e] + s.new_flow[e], s.priority[e]);
+    }
+    count.add(count.clamps, new_height < height);
+    height = new_height;
+    return details::make_field(std::vector<device_t>(s.ids), std::vector<long long>(s.result));
+}
+
+//! @brief Round of push-relabel by the fused kernel, checked against the reference one.
+template <typename node_t, typename M, typename K>
+field<long long> push_relabel_step(node_t& node, trace_t call_point, field<tuple<long long, int>> const& flow_height, field<long long> const& old_values, field<long long> const& capacity, bool is_source, bool is_sink, int node_num, int& height, long long& e_flow, K& count, M multi_push, std::integral_constant<variants::kernel, variants::kernel::checked>) {
+    int ref_height = height;
+    long long ref_e_flow = e_flow;
+    K ref_count;
+    field<long long> ref = push_relabel_step(CALL, flow_height, old_values, capacity, is_source, is_sink, node_num, ref_height, ref_e_flow, ref_count, multi_push, std::integral_constant<variants::kernel, variants::kernel::reference>{});
+    field<long long> result = push_relabel_step(CALL, flow_height, old_values, capacity, is_source, is_sink, node_num, height, e_flow, count, multi_push, std::integral_constant<variants::kernel, variants::kernel::fused>{});
+    bool equal = ref_height == height and ref_e_flow == e_flow;
+    field<bool> diff = ref != result;
+    for (bool d : details::get_vals(diff)) equal = equal and not d;
+    if (not equal) {
+        std::cerr << "fused kernel mismatch at node " << node.uid << " time " << node.current_time() << ": height " << height << " vs " << ref_height << ", excess " << e_flow << " vs " << ref_e_flow << std::endl;
+        std::abort();
+    }
+    return result;
+}
+
+//! @brief Function returning the initial packed flows towards neighbours and height of a node (from the checkpoint to resume from, or the shared reference state, if given), and whether they come from it.
+FUN tuple<field<long long>, int, bool> initial_state(ARGS) { CODE
+    using namespace tags;
+    bool first = old(CALL, true, false);
+    if (not first) return make_tuple(field<long long>(0), 0, false);
+    // flows towards neighbours (packed by a function) and height, from CSR arrays and heights of all nodes
+    auto seed = [&](device_capacities<long long> const& flows, std::vector<int> const& heights, auto pack){
+        int begin = flows.start[node.uid-1], end = flows.start[node.uid];
+        std::vector<device_t> ids(flows.head.begin() + begin, flows.head.begin() + end);
+        std::vector<long long> values(1, 0);
+        for (int a = begin; a < end; ++a)
+            values.push_back(pack(flows.capacity[a]));
+        return make_tuple(details::make_field(std::move(ids), std::move(values)), heights[node.uid-1], true);
+    };
+    std::shared_ptr<const checkpoint> const& resumed = node.net.storage(checkpoint_in{});
+    // only flows, heights and round counts are restored: the sharing round and any other state starting over
+    // make a resumed run differ from a continued one for a transient
+    if (resumed != nullptr and int(node.uid) <= resumed->size()) {
+        node.storage(round_count{}) = resumed->rounds[node.uid-1];
+        return seed(resumed->flows, resumed->heights, [](long long p){ return p; });
+    }
+    std::shared_ptr<const tests::warm_start<long long>> const& state = node.net.storage(reference_state{});
+    if (state == nullptr or int(node.uid) > state->flows.size())
+        return make_tuple(field<long long>(0), 0, false);
+    return seed(state->flows, state->heights, [](long long f){ return pack_flow(f, 0); });
+}
+//! @brief Export types used by the initial_state function.
+FUN_EXPORT initial_state_t = export_list<bool>;
+
+//! @brief Function recording the packed flows towards neighbours and height of a node in the checkpoint being collected (if any, from its time on).
+FUN void record_checkpoint(ARGS, field<long long> const& flows, int height) {
+    using namespace tags;
+    std::shared_ptr<checkpoint_recorder> const& recorder = node.net.storage(checkpoint_out{});
+    if (recorder == nullptr or node.current_time() < recorder->time or recorder->recorded(node.uid)) return;
+    std::vector<device_t> const& ids = details::get_ids(flows);
+    std::vector<long long> const& values = details::get_vals(flows);
+    recorder->record(node.uid, std::vector<int>(ids.begin(), ids.end()), std::vector<long long>(values.begin() + 1, values.end()), height, node.storage(round_count{}));
+}
+
+//! @brief Function skipping rounds before the start time (by whole round periods to keep the offset of rounds within them, and counting them), returning whether the round is skipped.
+FUN bool await_start(ARGS) {
+    using namespace tags;
+    times_t start = node.net.storage(start_time{});
+    if (node.current_time() >= start) return false;
+    times_t period = node.net.storage(round_period{});
+    int skipped = std::ceil((start - node.current_time()) / period);
+    // network storage is updated without synchronisation, as only batch simulations (which are sequential) skip rounds
+    node.net.storage(skipped_rounds{}) += skipped;
+    node.next_time(node.current_time() + skipped * period);
+    return true;
+}
+
+//! @brief Function not estimating the size of exports.
+FUN void estimate_message_bytes(ARGS, field<long long> const&, field<long long> const&, int, std::false_type) {}
+//! @brief Function estimating the size of the export of the node if delta-encoded compactly, and with the previous layout (the export sent is a full field either way).
+FUN void estimate_message_bytes(ARGS, field<long long> const& o_flow, field<long long> const& packed, int height, std::true_type) { CODE
+    using namespace tags;
+    // neighbour entries with unchanged flow and no priority would be omitted, the others would carry
+    // their id and the zig-zag varint of the packed delta from the acknowledged flow
+    field<size_t> entry_bytes = map_hood([&](long long p, long long in, int uid){
+        long long delta = pack_flow(unpack_flow(p) + unpack_flow(in), unpack_priority(p));
+        return delta == 0 ? size_t(0) : varint_size(uid) + zigzag_size(delta);
+    }, o_flow, packed, nbr_uid(CALL));
+    node.storage(message_bytes_estimate{}) = varint_size(height) + sum_hood(CALL, entry_bytes, size_t(0)) + 1;
+    // previous layout: a flow, a priority and two ids for each neighbour, and a height and a source flag
+    node.storage(raw_message_bytes_estimate{}) = sum_hood(CALL, field<size_t>(8 + 4 + 2 * sizeof(device_t)), size_t(0)) + sizeof(int) + sizeof(bool);
+}
+
+//! @brief Aggregate Push-Relabel algorithm, calculating excess flow and height of nodes (and whether flows and height are unchanged).
+template <typename node_t, typename V = variants::standard>
+tuple<long long, int, bool> aggregate_push_relabel(node_t& node, trace_t call_point, bool is_source, bool is_sink, field<long long> const& capacity, int node_num, tuple<field<long long>, int, bool> const& start, V = {}) { CODE
+    using namespace tags;
+    long long e_flow = 0;
+    int height = 0;
+    bool stable = false;
+    // flows towards neighbours, packed with their priorities, and height
+    tuple<field<long long>, int> init(get<0>(start), get<1>(start));
 
-            height = min_hood(CALL, mux(res_capacity > 0 and nbr_height + 1 < height, nbr_height, height));
-            return make_tuple(flow + new_flow, nbr_priority);
+    nbr(CALL, init, [&](field<tuple<long long, int>> const& flow_height){
+        // a node seeded from the reference state shares it with its neighbours before its first round
+        if (get<2>(start)) {
+            height = get<1>(init);
+            return init;
+        }
+        // flows received from neighbours, packed with their priorities
+        field<long long> packed = get<0>(flow_height);
+
+        height = get<1>(self(CALL, flow_height));
+        int old_height = height;
+
+        field<long long> o_flow = map_hood([](long long p){
+            return pack_flow(-unpack_flow(p), unpack_priority(p));
+        }, packed);
+
+        o_flow = old(CALL, o_flow, [&](field<long long> const& old_values){
+            round_counters<V::counters> count;
+            field<long long> result = push_relabel_step(CALL, flow_height, old_values, capacity, is_source, is_sink, node_num, height, e_flow, count, std::integral_constant<bool, V::multi_push>{}, std::integral_constant<variants::kernel, V::round_kernel>{});
+            if constexpr (V::counters) {
+                node.storage(relabel_count{}) = count.relabels;
+                node.storage(push_count{}) = count.pushes;
+                node.storage(rollback_count{}) = count.rollbacks;
+                node.storage(truncation_count{}) = count.truncations;
+                node.storage(clamp_count{}) = count.clamps;
+            }
+            stable = height == old_height and sum_hood(CALL, mux(result != old_values, 1, 0), 0) == 0;
+            return result;
         });
-        flow = get<0>(o_flow);
-        return make_tuple(flow, height, nbr_priority);
+
+        estimate_message_bytes(CALL, o_flow, packed, height, std::integral_constant<bool, V::message_estimate>{});
+
+        int lifted = global_relabel(CALL, is_sink, capacity, o_flow, height, node_num, std::integral_constant<bool, V::relabel>{});
+        if (not is_source) {
+            stable = stable and lifted == height;
+            height = lifted;
+        }
+        record_checkpoint(CALL, o_flow, height);
+        return make_tuple(o_flow, height);
     });
     
-    return make_tuple(e_flow, height);
+    return make_tuple(e_flow, height, stable);
 }
 //! @brief Export types used by the aggregate_push_relabel function.
-FUN_EXPORT aggregate_push_relabel_t = export_list<tuple<field<long long>, int, field<int>>, field<long long>, bool, int, field<int>, tuple<field<long long>, field<int>>>;
+FUN_EXPORT aggregate_push_relabel_t = export_list<tuple<field<long long>, int>, field<long long>, global_relabel_t>;
+
+//! @brief Function applying to capacities the changes of the states of the scenario reached since the last round, returning the current state.
+FUN int apply_scenario(ARGS) { CODE
+    using namespace tags;
+    scenario const& s = *node.net.storage(network_scenario{});
+    int state = s.at(node.current_time());
+    int applied = old(CALL, -1, state);
+    for (int i = applied + 1; i <= state; ++i) {
+        auto changed = s.changed(i, node.uid);
+        if (changed.first == changed.second) continue;
+        field<long long>& capacity = node.storage(edge_capacities{});
+        std::vector<device_t> ids = details::get_ids(capacity);
+        std::vector<long long> values = details::get_vals(capacity);
+        for (auto c = changed.first; c != changed.second; ++c) {
+            size_t k = std::lower_bound(ids.begin(), ids.end(), device_t(get<1>(*c))) - ids.begin();
+            if (k < ids.size() and ids[k] == device_t(get<1>(*c))) {
+                values[k+1] = get<2>(*c);
+            } else {
+                ids.insert(ids.begin() + k, get<1>(*c));
+                values.insert(values.begin() + k + 1, get<2>(*c));
+            }
+        }
+        capacity = details::make_field(std::move(ids), std::move(values));
+    }
+    return state;
+}
+//! @brief Export types used by the apply_scenario function.
+FUN_EXPORT apply_scenario_t = export_list<int>;
+
+//! @brief Function keeping rounds at the frequency of the schedule.
+FUN void adaptive_schedule(ARGS, bool, std::false_type) {}
+//! @brief Function slowing rounds down exponentially while the node and its neighbours are quiescent.
+FUN void adaptive_schedule(ARGS, bool quiescent, std::true_type) { CODE
+    using namespace tags;
+    bool calm = quiescent and sum_hood(CALL, mux(nbr(CALL, quiescent), 0, 1), 0) == 0;
+    // a change in the neighbourhood resets the frequency, but only once noticed at the next round of the node
+    // (up to max_backoff periods later): rounds are scheduled by the node, and not triggered by messages
+    real_t slowdown = old(CALL, real_t(1), [&](real_t s){
+        return calm ? min(2 * s, real_t(max_backoff)) : real_t(1);
+    });
+    node.frequency(1 / slowdown);
+    // wake up in time for the next change of the network
+    times_t next_change = node.net.storage(network_scenario{})->next_change(node.current_time());
+    if (node.next_time() > next_change)
+        node.next_time(next_change);
+}
+//! @brief Export types used by the adaptive_schedule function.
+FUN_EXPORT adaptive_schedule_t = export_list<bool, real_t>;
+
+//! @brief Function running every round until the end.
+FUN void early_stop(ARGS, int, long long, bool, std::false_type) {}
+//! @brief Function tracking convergence of the sink flow in every state of the network, and skipping rounds to the next change once every node is quiescent.
+FUN void early_stop(ARGS, int phase, long long flow, bool quiescent, std::true_type) { CODE
+    using namespace tags;
+    // network storage is updated without synchronisation, as simulations are sequential
+    scenario const& s = *node.net.storage(network_scenario{});
+    times_t t = node.current_time();
+    times_t phase_start = s.start[phase];
+    if (flow != node.storage(sink_flow{})) {
+        node.net.storage(total_sink_flow{}) += flow - node.storage(sink_flow{});
+        node.net.storage(last_flow_change{}) = t;
+    }
+    // elapsed time while the flow is not ideal, time of the last change since it is
+    times_t convergence = t - phase_start;
+    if (node.net.storage(total_sink_flow{}) == node.storage(ideal_flow{}))
+        convergence = max(node.net.storage(last_flow_change{}) - phase_start, times_t(0));
+    node.storage(convergence_time{}) = convergence;
+    std::vector<real_t>& history = node.net.storage(convergence_history{});
+    history.resize(s.size());
+    history[phase] = max(history[phase], real_t(convergence));
+
+    bool was_quiescent = old(CALL, false, quiescent);
+    node.net.storage(quiescent_nodes{}) += int(quiescent) - int(was_quiescent);
+    // skips are at most time_step long, so that messages (retained as long) do not expire
+    if (node.net.storage(quiescent_nodes{}) == node.net.storage(node_number{})) {
+        times_t next_phase = min(times_t(s.next_change(t)), t + time_step);
+        node.next_time(phase + 1 < s.size() ? next_phase : TIME_MAX);
+    }
+}
+//! @brief Export types used by the early_stop function.
+FUN_EXPORT early_stop_t = export_list<bool>;
+
+//! @brief Function loading capacities of edges from the shared CSR capacities, if given and not loaded yet.
+FUN void load_capacities(ARGS) {
+    using namespace tags;
+    std::shared_ptr<const device_capacities<long long>> const& csr = node.net.storage(capacity_csr{});
+    if (csr == nullptr or int(node.uid) > csr->size()) return;
+    int begin = csr->start[node.uid-1], end = csr->start[node.uid];
+    field<long long>& capacity = node.storage(edge_capacities{});
+    if (begin == end or not details::get_ids(capacity).empty()) return;
+    std::vector<device_t> ids(csr->head.begin() + begin, csr->head.begin() + end);
+    std::vector<long long> values(1, 0);
+    values.insert(values.end(), csr->capacity.begin() + begin, csr->capacity.begin() + end);
+    capacity = details::make_field(std::move(ids), std::move(values));
+}
 
 //! @brief Main function.
-template <bool graphic>
+template <bool graphic, typename V = variants::standard>
 struct main {
     template <typename node_t>
     void operator()(node_t& node, times_t) {
         using namespace tags;
+        trace_span span("round");
+        if (await_start(CALL)) return;
         disperser(CALL, std::integral_constant<bool,graphic>{});
 
         int node_num = node.net.storage(node_number{});
-        field<long long> capacity = node.storage(edge_capacities{});
-        bool is_source = (node.current_time() < 3*time_step and node.uid == 1) or (node.current_time() > 1*time_step and node.uid == 2);
-        bool is_sink = (node.current_time() < 4*time_step and node.uid == node_num) or (node.current_time() > 2*time_step and node.uid == node_num-1);
+        load_capacities(CALL);
+        int state = apply_scenario(CALL);
+        // capacities only change with the state of the network, and are read in place
+        field<long long> const& capacity = node.storage(edge_capacities{});
+        scenario const& s = *node.net.storage(network_scenario{});
+        bool is_source = s.is_source(state, node.uid);
+        bool is_sink = s.is_sink(state, node.uid);
         // bool is_sink = node.uid == node_num /*|| (node.uid == 2 && node.current_time() > 200)*/;
         // bool is_source = node.uid == 1;
         long long e_flow;
         int height;
-        tie(e_flow, height) = aggregate_push_relabel(CALL, is_source, is_sink, capacity, node_num);
+        bool stable;
+        tie(e_flow, height, stable) = aggregate_push_relabel(CALL, is_source, is_sink, capacity, node_num, initial_state(CALL), V{});
+        // neighbours are only counted when tracing, as the fold would otherwise run every round for nothing
+        if (tracer::instance().enabled()) {
+            size_t bytes = 0;
+            if constexpr (V::message_estimate) bytes = node.storage(message_bytes_estimate{});
+            span.moved(sum_hood(CALL, field<int>(1), 0), bytes);
+        }
+        bool quiescent = stable and (is_source or is_sink or e_flow == 0);
+        adaptive_schedule(CALL, quiescent, std::integral_constant<bool,V::adaptive>{});
+        node.storage(round_count{}) += 1;
 
 
-        long long ideal = node.net.storage(ideal_flow_history{})[node.current_time() / time_step];
+        long long ideal = node.net.storage(ideal_flow_history{})[state];
         node.storage(ideal_flow{}) = ideal;
+        early_stop(CALL, state, is_sink ? e_flow : 0, quiescent, std::integral_constant<bool,V::early_stop>{});
         node.storage(sink_flow{}) = is_sink ? e_flow : 0;
         node.storage(source_flow{}) = is_source ? -e_flow : 0;
         node.storage(excess_flow{}) = e_flow;
@@ -198,7 +825,7 @@ struct main {
     }
 };
 //! @brief Export types used by the MAIN function.
-FUN_EXPORT main_t = export_list<disperser_t, aggregate_push_relabel_t>;
+FUN_EXPORT main_t = export_list<disperser_t, initial_state_t, apply_scenario_t, aggregate_push_relabel_t, adaptive_schedule_t, early_stop_t>;
 
 } // namespace coordination
 
@@ -218,26 +845,52 @@ using namespace component::tags;
 //! @brief Import tags used by aggregate functions.
 using namespace coordination::tags;
 
-//! @brief When to end the simulation.
-constexpr size_t end = 5*time_step;
+//! @brief When to end the simulation (by default).
+constexpr size_t end = phase_number*time_step;
 
-//! @brief Description of the round schedule.
+//! @brief Description of the round schedule (period, deviation and end read from the initialisation values).
 template <bool sync>
 using round_s = std::conditional_t<
     sync,
-    sequence::periodic_n<2, 1, 2, 2*end+2>,          // one round at every half second
     sequence::periodic<
-        distribution::interval_n<times_t, 0, 1>,     // uniform time in the [0,1] interval for start
-        distribution::weibull_n<times_t, 10, 1, 10>, // weibull-distributed time for interval (10/10=1 mean, 1/10=0.1 deviation)
-        distribution::constant_n<times_t, end+3>
+        distribution::constant_n<times_t, 1, 2>,            // first round at half a second
+        distribution::constant_i<times_t, round_period>,    // one round every period
+        distribution::constant_i<times_t, end_time>
+    >,
+    sequence::periodic<
+        distribution::interval_n<times_t, 0, 1>,            // uniform time in the [0,1] interval for start
+        distribution::weibull_i<times_t, round_period, round_deviation>, // weibull-distributed time for interval
+        distribution::constant_i<times_t, end_time>
     >
 >;
-//! @brief The sequence of network snapshots (one every simulated second).
-using log_s = sequence::periodic_n<1, 1, 1, end>;
+//! @brief The sequence of network snapshots (one every simulated second, until the end read from the initialisation values).
+using log_s = sequence::periodic<
+    distribution::constant_n<times_t, 1>,
+    distribution::constant_n<times_t, 1>,
+    distribution::constant_i<times_t, end_time>
+>;
 //! @brief The distribution of initial node positions (random in a square).
 using rectangle_d = distribution::rect_n<1, 0, 0, area_size, area_size>;
-//! @brief The contents of the node storage as tags and associated types.
-using store_t = node_store<
+//! @brief A sequence of types if enabled, and an empty one otherwise.
+template <bool enabled, typename... Ts>
+using enabled_if = std::conditional_t<enabled, common::type_sequence<Ts...>, common::type_sequence<>>;
+
+//! @brief Template O instantiated on the concatenation of sequences of types.
+template <template <class...> class O, typename... Ss>
+struct joined;
+template <template <class...> class O, typename... Ts>
+struct joined<O, common::type_sequence<Ts...>> {
+    using type = O<Ts...>;
+};
+template <template <class...> class O, typename... Ts, typename... Us, typename... Ss>
+struct joined<O, common::type_sequence<Ts...>, common::type_sequence<Us...>, Ss...> : joined<O, common::type_sequence<Ts..., Us...>, Ss...> {};
+//! @brief Template O instantiated on the concatenation of sequences of types.
+template <template <class...> class O, typename... Ss>
+using joined_t = typename joined<O, Ss...>::type;
+
+//! @brief The contents of the node storage as tags and associated types (for a given variant of the algorithm).
+template <typename V>
+using store_t = joined_t<node_store, common::type_sequence<
     node_color,                 color,
     node_size,                  double,
     node_shape,                 shape,
@@ -246,14 +899,37 @@ using store_t = node_store<
     ideal_flow,                 long long,
     edge_capacities,            field<long long>,
     excess_flow,                long long,
-    node_height,                int
->;
-//! @brief The tags and corresponding aggregators to be logged.
-using aggregator_t = aggregators<
+    node_height,                int,
+    round_count,                int,
+    convergence_time,           real_t
+>, enabled_if<V::counters,
+    relabel_count,              int,
+    push_count,                 int,
+    rollback_count,             int,
+    truncation_count,           int,
+    clamp_count,                int
+>, enabled_if<V::message_estimate,
+    message_bytes_estimate,     size_t,
+    raw_message_bytes_estimate, size_t
+>>;
+//! @brief The tags and corresponding aggregators to be logged (for a given variant of the algorithm).
+template <typename V>
+using aggregator_t = joined_t<aggregators, common::type_sequence<
     sink_flow,      aggregator::sum<long long>,
     source_flow,    aggregator::sum<long long>,
-    ideal_flow,     aggregator::max<real_t>
->;
+    ideal_flow,     aggregator::max<real_t>,
+    round_count,        aggregator::sum<int>,
+    convergence_time,   aggregator::max<real_t>
+>, enabled_if<V::counters,
+    relabel_count,      aggregator::combine<aggregator::sum<int>, aggregator::max<int>>,
+    push_count,         aggregator::combine<aggregator::sum<int>, aggregator::max<int>>,
+    rollback_count,     aggregator::combine<aggregator::sum<int>, aggregator::max<int>>,
+    truncation_count,   aggregator::combine<aggregator::sum<int>, aggregator::max<int>>,
+    clamp_count,        aggregator::combine<aggregator::sum<int>, aggregator::max<int>>
+>, enabled_if<V::message_estimate,
+    message_bytes_estimate,     aggregator::sum<size_t>,
+    raw_message_bytes_estimate, aggregator::sum<size_t>
+>>;
 
 //! @brief The tags and functors computing derived properties to be logged.
 using functors_t = log_functors<
@@ -270,30 +946,367 @@ using absolute_plot = plot::split<plot::time, lines_t<aggregator::sum<sink_flow>
 //! @brief Plot with absolute flow values.
 using relative_plot = plot::split<plot::time, lines_t<sink_flow__error>>;
 
-//! @brief Overall plot description.
-using plot_row = plot::join<absolute_plot, relative_plot>;
+//! @brief Plot with estimated message sizes, compact against previous layout.
+using message_plot = plot::split<plot::time, lines_t<aggregator::sum<message_bytes_estimate>, aggregator::sum<raw_message_bytes_estimate>>>;
+
+//! @brief Plot with the total number of rounds executed.
+using round_plot = plot::split<plot::time, lines_t<aggregator::sum<round_count>>>;
+
+//! @brief Plot with the time since the last change of sources and sinks needed for the sink flow to become ideal.
+using convergence_plot = plot::split<plot::time, lines_t<aggregator::max<convergence_time>>>;
+
+//! @brief Plot with the number of events of each mechanism of the algorithm in a round.
+using counter_plot = plot::split<plot::time, lines_t<aggregator::sum<relabel_count>, aggregator::sum<push_count>, aggregator::sum<rollback_count>, aggregator::sum<truncation_count>, aggregator::sum<clamp_count>>>;
+
+//! @brief Plot with the maximum number of events of each mechanism of the algorithm at a node in a round.
+using counter_max_plot = plot::split<plot::time, lines_t<aggregator::max<relabel_count>, aggregator::max<push_count>, aggregator::max<rollback_count>, aggregator::max<truncation_count>, aggregator::max<clamp_count>>>;
+
+//! @brief Plot with the convergence time of every test, for every state of the network (with early stop only, from rows given after the simulations).
+using test_convergence_plot = plot::split<network_state, plot::split<test_id, lines_t<convergence_time>>>;
+
+//! @brief Overall plot description (for a given variant of the algorithm).
+template <typename V>
+using plot_row = joined_t<plot::join, common::type_sequence<absolute_plot, relative_plot>, enabled_if<V::message_estimate, message_plot>, common::type_sequence<round_plot, convergence_plot>, enabled_if<V::counters, counter_plot, counter_max_plot>>;
+
+//! @brief Overall plot description (for a given variant of the algorithm).
+template <typename V = variants::standard>
+using plot_t = plot::join<plot_row<V>, plot::split<test_id, plot_row<V>>>;
+
+//! @brief Extracts the values of a row of type S from a logged row.
+template <typename S, typename R, typename... Ss, typename... Ts>
+S extract_row(R const& row, common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> const&) {
+    return common::make_tagged_tuple<Ss...>(static_cast<Ts>(common::get<Ss>(row))...);
+}
+//! @brief Extracts the values of a row of type S from a logged row.
+template <typename S, typename R>
+S extract_row(R const& row) {
+    return extract_row<S>(row, S{});
+}
+
+//! @brief Plotter recording the plotted values of rows (as rows of type S), to be replayed later into a plotter of type P.
+template <typename P, typename S>
+class plot_buffer {
+  public:
+    //! @brief Records a row.
+    template <typename R>
+    plot_buffer& operator<<(R const& row) {
+        trace_span span("log");
+        m_rows.push_back(extract_row<S>(row));
+        return *this;
+    }
+
+    //! @brief Inserts the rows recorded into a plotter, in order.
+    void replay(P& p) const {
+        for (S const& r : m_rows) p << r;
+    }
+
+  private:
+    //! @brief The rows recorded.
+    std::vector<S> m_rows;
+};
+
+//! @brief Plotter passing rows to a plotter of type P, and timing how long (in simulated and wall-clock time) the sink flow takes to get within an error threshold of the ideal one after every change of the network.
+template <typename P>
+class threshold_timer {
+  public:
+    //! @brief Passes rows to a plotter, for a given relative error threshold (from 0 to 1) and states of the network over time.
+    threshold_timer(P& p, real_t threshold, scenario const& s) : m_plotter(p), m_threshold(threshold), m_scenario(s), m_times(s.size(), -1), m_wall_times(s.size(), -1) {}
+
+    //! @brief Passes a row on, noting when the error first gets within the threshold in its state.
+    template <typename R>
+    threshold_timer& operator<<(R const& row) {
+        auto now = std::chrono::steady_clock::now();
+        times_t t = common::get<plot::time>(row);
+        int state = m_scenario.at(t);
+        // the wall time of a state is counted from its first row
+        if (state != m_state) {
+            m_state = state;
+            m_start = now;
+        }
+        if (m_times[state] < 0 and common::get<sink_flow__error>(row) <= m_threshold) {
+            m_times[state] = t - m_scenario.start[state];
+            m_wall_times[state] = std::chrono::duration<real_t>(now - m_start).count();
+        }
+        m_plotter << row;
+        return *this;
+    }
+
+    //! @brief The simulated time taken to get within the threshold in every state (negative if never).
+    std::vector<real_t> const& times() const {
+        return m_times;
+    }
+
+    //! @brief The wall-clock seconds taken to get within the threshold in every state (negative if never).
+    std::vector<real_t> const& wall_times() const {
+        return m_wall_times;
+    }
+
+  private:
+    //! @brief The plotter rows are passed to.
+    P& m_plotter;
+    //! @brief The relative error threshold.
+    real_t m_threshold;
+    //! @brief The states of the network over time.
+    scenario const& m_scenario;
+    //! @brief The state of the last row.
+    int m_state = -1;
+    //! @brief When the first row of the last state was logged.
+    std::chrono::steady_clock::time_point m_start;
+    //! @brief The simulated time taken to get within the threshold in every state (negative if never).
+    std::vector<real_t> m_times;
+    //! @brief The wall-clock seconds taken to get within the threshold in every state (negative if never).
+    std::vector<real_t> m_wall_times;
+};
+
+//! @brief The values of a logged row that are plotted by plot_t<V> (written by row_stream, read back by read_rows).
+template <typename V = variants::standard>
+using stream_row = joined_t<common::tagged_tuple_t, common::type_sequence<
+    plot::time,                             times_t,
+    test_id,                                int,
+    aggregator::sum<sink_flow>,             long long,
+    aggregator::max<ideal_flow>,            real_t,
+    sink_flow__error,                       real_t,
+    aggregator::sum<round_count>,           int,
+    aggregator::max<convergence_time>,      real_t
+>, enabled_if<V::counters,
+    aggregator::sum<relabel_count>,         int,
+    aggregator::sum<push_count>,            int,
+    aggregator::sum<rollback_count>,        int,
+    aggregator::sum<truncation_count>,      int,
+    aggregator::sum<clamp_count>,           int,
+    aggregator::max<relabel_count>,         int,
+    aggregator::max<push_count>,            int,
+    aggregator::max<rollback_count>,        int,
+    aggregator::max<truncation_count>,      int,
+    aggregator::max<clamp_count>,           int
+>, enabled_if<V::message_estimate,
+    aggregator::sum<message_bytes_estimate>,        size_t,
+    aggregator::sum<raw_message_bytes_estimate>,    size_t
+>>;
+
+//! @brief Magic number at the start of binary row files.
+constexpr char stream_magic[8] = {'P', 'R', 'R', 'O', 'W', 'S', 0, 1};
+
+//! @brief Writes a value of a row as CSV, with non-finite reals as "inf", "-inf" and "nan".
+template <typename T>
+void write_value(std::ostream& out, T const& x) {
+    if constexpr (std::is_floating_point<T>::value) {
+        if (std::isnan(x)) out << "nan";
+        else if (std::isinf(x)) out << (x > 0 ? "inf" : "-inf");
+        else out << x;
+    } else out << x;
+}
+
+//! @brief Parses a value of a row from CSV (including non-finite reals), returning whether the whole token is one.
+template <typename T>
+bool parse_value(std::string const& token, T& x) {
+    char const* begin = token.c_str();
+    char* end = nullptr;
+    errno = 0;
+    if constexpr (std::is_floating_point<T>::value) x = static_cast<T>(std::strtod(begin, &end));
+    else if constexpr (std::is_signed<T>::value) {
+        long long y = std::strtoll(begin, &end, 10);
+        x = static_cast<T>(y);
+        if (y != static_cast<long long>(x)) return false;
+    } else {
+        if (token[0] == '-') return false;
+        unsigned long long y = std::strtoull(begin, &end, 10);
+        x = static_cast<T>(y);
+        if (y != static_cast<unsigned long long>(x)) return false;
+    }
+    return not token.empty() and *end == 0 and errno == 0;
+}
+
+//! @brief Plotter writing rows of type S to a file as they are logged (as CSV or binary), in bounded memory and shared by concurrent simulations.
+template <typename S>
+class row_stream {
+  public:
+    //! @brief Opens the file, writing its header (column names, or magic number and column count).
+    row_stream(std::string const& file, bool binary) : m_file(file, binary ? std::ios::binary : std::ios::out), m_binary(binary) {
+        header(S{});
+    }
+
+    //! @brief Writes the plotted values of a row, flushing every flush_rows rows.
+    template <typename R>
+    row_stream& operator<<(R const& row) {
+        trace_span span("log");
+        S r = extract_row<S>(row);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        write(r, r);
+        if (++m_rows % flush_rows == 0) m_file.flush();
+        return *this;
+    }
+
+    //! @brief Whether every row has been written successfully.
+    explicit operator bool() const {
+        return static_cast<bool>(m_file);
+    }
+
+  private:
+    //! @brief Rows between flushes, so that progress is visible while simulations run.
+    static constexpr size_t flush_rows = 1024;
+
+    //! @brief Writes the file header.
+    template <typename... Ss, typename... Ts>
+    void header(common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> const&) {
+        if (m_binary) {
+            uint64_t columns = sizeof...(Ss);
+            m_file.write(stream_magic, sizeof(stream_magic));
+            m_file.write(reinterpret_cast<char const*>(&columns), sizeof(columns));
+            return;
+        }
+        std::string names[] = {common::type_name<Ss>()...};
+        for (size_t i = 0; i < sizeof...(Ss); ++i)
+            m_file << (i ? "," : "") << '"' << names[i] << '"';
+        m_file << "\n";
+        m_file.precision(std::numeric_limits<double>::max_digits10);
+    }
 
-//! @brief Overall plot description.
-using plot_t = plot::join<plot_row, plot::split<test_id, plot_row>>;
+    //! @brief Writes a row.
+    template <typename... Ss, typename... Ts>
+    void write(S const& r, common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> const&) {
+        if (m_binary) {
+            int expand[] = {(m_file.write(reinterpret_cast<char const*>(&common::get<Ss>(r)), sizeof(Ts)), 0)...};
+            (void)expand;
+            return;
+        }
+        size_t i = 0;
+        int expand[] = {(m_file << (i++ ? "," : ""), write_value(m_file, common::get<Ss>(r)), 0)...};
+        (void)expand;
+        m_file << "\n";
+    }
+
+    //! @brief The output file.
+    std::ofstream m_file;
+    //! @brief Whether the file is binary.
+    bool m_binary;
+    //! @brief Rows written so far.
+    size_t m_rows = 0;
+    //! @brief Serialises rows from concurrent simulations.
+    std::mutex m_mutex;
+};
+
+//! @brief Reads rows of a given type from a file written by a row_stream into a plotter, counting the rows rejected as unparsable (or truncated).
+template <typename P, typename... Ss, typename... Ts>
+size_t read_rows(std::string const& file, P& p, size_t& rejected, common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> r) {
+    std::ifstream in(file, std::ios::binary);
+    char magic[sizeof(stream_magic)] = {};
+    uint64_t columns = 0;
+    size_t rows = 0;
+    rejected = 0;
+    if (in.read(magic, sizeof(magic)) and memcmp(magic, stream_magic, sizeof(magic)) == 0) {
+        if (not in.read(reinterpret_cast<char*>(&columns), sizeof(columns)) or columns != sizeof...(Ss)) return 0;
+        while (in.peek() != std::char_traits<char>::eof()) {
+            int expand[] = {(in.read(reinterpret_cast<char*>(&common::get<Ss>(r)), sizeof(Ts)), 0)...};
+            (void)expand;
+            if (not in) {
+                ++rejected;
+                return rows;
+            }
+            p << r;
+            ++rows;
+        }
+        return rows;
+    }
+    // CSV: skip the header, then parse comma-separated values
+    in.clear();
+    in.seekg(0);
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::vector<std::string> tokens;
+        std::istringstream values(line);
+        for (std::string token; std::getline(values, token, ',');) tokens.push_back(token);
+        bool parsed = tokens.size() == sizeof...(Ss);
+        size_t i = 0;
+        if (parsed) {
+            int expand[] = {(parsed = parse_value(tokens[i++], common::get<Ss>(r)) and parsed, 0)...};
+            (void)expand;
+        }
+        if (not parsed) {
+            ++rejected;
+            continue;
+        }
+        p << r;
+        ++rows;
+    }
+    return rows;
+}
+
+//! @brief The number of columns of rows of a given type.
+template <typename... Ss, typename... Ts>
+constexpr size_t row_columns(common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> const&) {
+    return sizeof...(Ss);
+}
+
+//! @brief The number of columns of a file written by a row_stream, from its header (0 if unreadable).
+inline size_t file_columns(std::string const& file) {
+    std::ifstream in(file, std::ios::binary);
+    char magic[sizeof(stream_magic)] = {};
+    uint64_t columns = 0;
+    if (in.read(magic, sizeof(magic)) and memcmp(magic, stream_magic, sizeof(magic)) == 0)
+        return in.read(reinterpret_cast<char*>(&columns), sizeof(columns)) ? columns : 0;
+    in.clear();
+    in.seekg(0);
+    std::string line;
+    if (not std::getline(in, line) or line.empty()) return 0;
+    // column names are quoted, and may contain commas
+    size_t columns = 1;
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') quoted = not quoted;
+        else if (c == ',' and not quoted) ++columns;
+    }
+    return columns;
+}
+
+//! @brief Reads rows written by a row_stream of a variant V back into a plotter, returning how many were read (and counting the ones rejected).
+template <typename V, typename P>
+size_t read_rows(std::string const& file, P& p, size_t& rejected) {
+    return read_rows(file, p, rejected, stream_row<V>{});
+}
+
+//! @brief Simulation parameters set at runtime, passed to the network through its initialisation values.
+using parameters = ::parameters;
+
+//! @brief Whether node rounds are run in parallel, checking that the variant allows it.
+template <bool par, typename V>
+constexpr bool parallel_rounds() {
+    static_assert(not par or not V::early_stop, "early stop updates the network storage without synchronisation, and needs sequential rounds");
+    return par;
+}
 
-//! @brief The general simulation options.
-template <bool par, bool sync, bool gui>
+//! @brief The general simulation options (for a given variant of the algorithm and plotter).
+template <bool par, bool sync, bool gui, typename V = variants::standard, typename P = plot_t<V>>
 DECLARE_OPTIONS(list,
-    parallel<par>,                      // multithreading enabled on node rounds
+    parallel<parallel_rounds<par, V>()>,// multithreading enabled on node rounds
     synchronised<sync>,                 // optimise for asynchronous networks
-    program<coordination::main<gui>>,   // program to be run (refers to MAIN above)
+    program<coordination::main<gui, V>>,// program to be run (refers to MAIN above)
     exports<coordination::main_t>,      // export type list (types used in messages)
-    retain<metric::retain<2,1>>,        // messages are kept for 2 seconds before expiring
+    retain<metric::retain<V::early_stop ? time_step+2 : V::adaptive ? 2*max_backoff : 2, 1>>, // messages are kept for 2 seconds (or two slowed-down or skipped rounds) before expiring
     round_schedule<round_s<sync>>,      // the sequence generator for round events on nodes
     log_schedule<log_s>,                // the sequence generator for log events on the network
     net_store<                          // overall parameters stored at the network level
         node_number,        int,
-        ideal_flow_history, std::vector<long long>
+        ideal_flow_history, std::vector<long long>,
+        capacity_csr,       std::shared_ptr<const device_capacities<long long>>,
+        reference_state,    std::shared_ptr<const tests::warm_start<long long>>,
+        network_scenario,   std::shared_ptr<const scenario>,
+        checkpoint_out,     std::shared_ptr<checkpoint_recorder>,
+        checkpoint_in,      std::shared_ptr<const checkpoint>,
+        start_time,         times_t,
+        skipped_rounds,     long long,
+        area_side,          real_t,
+        round_period,       times_t,
+        convergence_history,std::vector<real_t>,
+        total_sink_flow,    long long,
+        last_flow_change,   times_t,
+        quiescent_nodes,    int
     >,
-    store_t,            // the contents of the node storage
-    aggregator_t,       // the tags and corresponding aggregators to be logged
+    store_t<V>,         // the contents of the node storage
+    aggregator_t<V>,    // the tags and corresponding aggregators to be logged
     functors_t,         // description of derived quantities to be logged
-    plot_type<plot_t>,  // the plot description to be used
+    plot_type<P>,       // the plot description to be used
     area<0, 0, area_size, area_size>,   // the simulation area
     init<                   // random node initialization
         x,          rectangle_d
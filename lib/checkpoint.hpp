@@ -0,0 +1,152 @@
+#ifndef PUSH_RELABEL_CHECKPOINT_H
+#define PUSH_RELABEL_CHECKPOINT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "topology.hpp"
+
+using namespace std;
+
+// State of the aggregate algorithm on every device at a given time, from which a simulation can be
+// resumed (also by a different variant of the algorithm, as the state is common to all of them).
+struct checkpoint {
+	double time = 0;         // time of the first round of devices taken into account
+	uint64_t hash = 0;       // content hash of the state of the network at that time
+	device_capacities<long long> flows; // packed flows (with their priorities) towards neighbours of each device
+	vector<int> heights;     // heights of devices
+	vector<int> rounds;      // rounds executed by devices
+
+	int size() const {
+		return static_cast<int>(heights.size());
+	}
+};
+
+namespace checkpoint_format {
+	constexpr char magic[8] = {'P', 'R', 'C', 'K', 'P', 'T', 0, 1};
+
+	// header following the magic
+	struct header {
+		double time;
+		uint64_t hash;
+		int64_t devices, arcs;
+	};
+}
+
+// Writes a checkpoint to a binary file, returning whether it succeeded: the magic and header, then
+// the CSR arrays of flows, the heights and the rounds of devices.
+inline bool write_checkpoint(string file_name, checkpoint const& c) {
+	std::ofstream file(file_name, std::ios::binary);
+	checkpoint_format::header h{c.time, c.hash, c.size(), static_cast<int64_t>(c.flows.head.size())};
+	file.write(checkpoint_format::magic, sizeof(checkpoint_format::magic));
+	file.write(reinterpret_cast<char const*>(&h), sizeof(h));
+	file.write(reinterpret_cast<char const*>(c.flows.start.data()), c.flows.start.size() * sizeof(int));
+	file.write(reinterpret_cast<char const*>(c.flows.head.data()), c.flows.head.size() * sizeof(int));
+	file.write(reinterpret_cast<char const*>(c.flows.capacity.data()), c.flows.capacity.size() * sizeof(long long));
+	file.write(reinterpret_cast<char const*>(c.heights.data()), c.heights.size() * sizeof(int));
+	file.write(reinterpret_cast<char const*>(c.rounds.data()), c.rounds.size() * sizeof(int));
+	return static_cast<bool>(file);
+}
+
+// Reads a checkpoint of a network with the given number of devices from a binary file (with no
+// devices if missing or invalid, or of a different network). The counts in the header are checked
+// against the expected devices and the length of the file before anything is allocated.
+inline checkpoint read_checkpoint(string file_name, int devices) {
+	checkpoint c;
+	std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+	streamoff length = file.tellg();
+	file.seekg(0);
+	char magic[sizeof(checkpoint_format::magic)];
+	checkpoint_format::header h;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, checkpoint_format::magic, sizeof(magic)) != 0 ||
+	    !file.read(reinterpret_cast<char*>(&h), sizeof(h))) {
+		return {};
+	}
+	// the arrays following the header take (devices + 1 + arcs + 2 devices) ints and arcs long longs
+	streamoff data = length - static_cast<streamoff>(sizeof(magic) + sizeof(h));
+	if (h.devices != devices || h.arcs < 0 || h.arcs > data / static_cast<streamoff>(sizeof(int) + sizeof(long long)) ||
+	    data != static_cast<streamoff>((3 * h.devices + 1 + h.arcs) * sizeof(int) + h.arcs * sizeof(long long))) {
+		return {};
+	}
+	c.time = h.time;
+	c.hash = h.hash;
+	c.flows.start.resize(h.devices + 1);
+	c.flows.head.resize(h.arcs);
+	c.flows.capacity.resize(h.arcs);
+	c.heights.resize(h.devices);
+	c.rounds.resize(h.devices);
+	file.read(reinterpret_cast<char*>(c.flows.start.data()), c.flows.start.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(c.flows.head.data()), c.flows.head.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(c.flows.capacity.data()), c.flows.capacity.size() * sizeof(long long));
+	file.read(reinterpret_cast<char*>(c.heights.data()), c.heights.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(c.rounds.data()), c.rounds.size() * sizeof(int));
+	if (!file || c.flows.start.front() != 0 || c.flows.start.back() != h.arcs || !is_sorted(c.flows.start.begin(), c.flows.start.end())) {
+		return {};
+	}
+	return c;
+}
+
+// Collects the state of devices at their first round from a given time (from concurrent rounds).
+class checkpoint_recorder {
+public:
+	checkpoint_recorder(int devices, double time, uint64_t hash) : devices(devices), time(time), hash(hash), heights(devices), rounds(devices), done(new atomic<bool>[devices]()) {}
+
+	// Whether a device has already been recorded (without locking, to be checked every round before
+	// collecting its state).
+	bool recorded(int device) const {
+		return device < 1 || device > devices || done[device - 1].load(memory_order_acquire);
+	}
+
+	// Records the state of a device (once), with the ids of its neighbours and the packed flows towards them.
+	void record(int device, vector<int> const& ids, vector<long long> const& flows, int height, int round) {
+		lock_guard<mutex> lock(m);
+		if (recorded(device)) {
+			return;
+		}
+		heights[device - 1] = height;
+		rounds[device - 1] = round;
+		for (size_t i = 0; i < ids.size(); i++) {
+			arcs.emplace_back(device, ids[i], flows[i]);
+		}
+		done[device - 1].store(true, memory_order_release);
+		count++;
+	}
+
+	// whether every device has been recorded
+	bool complete() const {
+		lock_guard<mutex> lock(m);
+		return count == devices;
+	}
+
+	checkpoint get() const {
+		lock_guard<mutex> lock(m);
+		checkpoint c;
+		c.time = time;
+		c.hash = hash;
+		c.flows = make_device_capacities(arcs, devices);
+		c.heights = heights;
+		c.rounds = rounds;
+		return c;
+	}
+
+	int const devices;
+	double const time;
+	uint64_t const hash;
+
+private:
+	mutable mutex m;
+	vector<tuple<int, int, long long>> arcs;
+	vector<int> heights, rounds;
+	unique_ptr<atomic<bool>[]> done;
+	int count = 0;
+};
+
+#endif
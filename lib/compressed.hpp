@@ -0,0 +1,279 @@
+#ifndef PUSH_RELABEL_COMPRESSED_H
+#define PUSH_RELABEL_COMPRESSED_H
+
+#include <climits>
+#include <cstdint>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "topology.hpp"
+
+using namespace std;
+
+// Synchronous-rounds push-relabel (as in basic_graph<policy::rounds>) over a compressed topology.
+// Opposite arcs are merged into a pair {u < v} carrying a single flow from u to v. Every vertex
+// stores its higher neighbours (the pairs it owns, numbered consecutively) and its lower
+// neighbours (with the increasing ids of their pairs) as delta-encoded varints, decoded on the
+// fly in discharge(). Capacities are stored in the narrow type C, with the larger ones (such as
+// those of virtual terminals) kept aside. Only flows, excesses and heights are uncompressed.
+template <typename T = long long, typename C = uint32_t>
+class compressed_graph {
+public:
+	compressed_graph(topology<T> const& t) {
+		int n = t.size();
+		source = t.source;
+		sink = t.sink;
+
+		// merged capacities towards each neighbour, sorted by neighbour
+		vector<vector<pair<int, T>>> adjacency(n);
+		for (int u = 0; u < n; u++) {
+			for (int a = t.start[u]; a < t.start[u + 1]; a++) {
+				adjacency[u].emplace_back(t.head[a], t.capacity[a]);
+			}
+			sort(adjacency[u].begin(), adjacency[u].end(), [](auto const& x, auto const& y) {
+				return x.first < y.first;
+			});
+			int k = 0;
+			for (size_t i = 0; i < adjacency[u].size(); i++) {
+				if (k > 0 && adjacency[u][k - 1].first == adjacency[u][i].first) {
+					adjacency[u][k - 1].second += adjacency[u][i].second;
+				}
+				else {
+					adjacency[u][k++] = adjacency[u][i];
+				}
+			}
+			adjacency[u].resize(k);
+		}
+
+		// pairs owned by each vertex, and the ids of the pairs it belongs to as higher endpoint
+		vector<vector<int>> lower_pairs(n);
+		upper_start.assign(n + 1, 0);
+		for (int u = 0; u < n; u++) {
+			upper_start[u + 1] = upper_start[u];
+			for (auto const& x : adjacency[u]) {
+				if (x.first > u) {
+					lower_pairs[x.first].push_back(upper_start[u + 1]++);
+				}
+			}
+		}
+		int pairs = upper_start[n];
+		capacity_up.resize(pairs);
+		capacity_down.resize(pairs);
+
+		upper_offset.assign(n + 1, 0);
+		lower_offset.assign(n + 1, 0);
+		for (int u = 0; u < n; u++) {
+			int p = upper_start[u], k = 0, last_lower = 0, last_upper = u, last_pair = 0;
+			for (auto const& x : adjacency[u]) {
+				if (x.first > u) {
+					encode(upper, x.first - last_upper);
+					last_upper = x.first;
+					capacity_up[p] = narrow(p, x.second, wide_up);
+					p++;
+				}
+				else {
+					// lower neighbours come with the (increasing) ids of their pairs
+					int q = lower_pairs[u][k++];
+					encode(lower, x.first - last_lower);
+					encode(lower, q - last_pair);
+					last_lower = x.first;
+					last_pair = q;
+					capacity_down[q] = narrow(q, x.second, wide_down);
+				}
+			}
+			upper_offset[u + 1] = upper.size();
+			lower_offset[u + 1] = lower.size();
+		}
+		sort(wide_up.begin(), wide_up.end());
+		sort(wide_down.begin(), wide_down.end());
+
+		height.assign(n, 0);
+		excess.assign(n, 0);
+		flow.assign(pairs, 0);
+		d_flow_low.assign(pairs, 0);
+		d_flow_high.assign(pairs, 0);
+	}
+
+	T get_max_flow() {
+		preflow();
+
+		int n = static_cast<int>(height.size());
+		int remaining = 1;
+		while (remaining > 0) {
+			remaining = 0;
+
+			#pragma omp parallel for reduction(+:remaining)
+			for (int u = 0; u < n; u++) {
+				if (u != source && u != sink && excess[u] > 0) {
+					remaining++;
+					discharge(u);
+				}
+			}
+			normalize_edges_flow();
+		}
+
+		return excess[sink];
+	}
+
+	// bytes used by the topology, capacities and mutable state
+	size_t memory() const {
+		return upper.size() + lower.size()
+		     + (upper_offset.size() + lower_offset.size()) * sizeof(size_t) + upper_start.size() * sizeof(int)
+		     + (capacity_up.size() + capacity_down.size()) * sizeof(C)
+		     + (wide_up.size() + wide_down.size()) * sizeof(pair<int, T>)
+		     + (flow.size() + d_flow_low.size() + d_flow_high.size() + excess.size()) * sizeof(T)
+		     + height.size() * sizeof(int);
+	}
+
+	int pairs() const {
+		return static_cast<int>(flow.size());
+	}
+
+private:
+	static constexpr C wide = numeric_limits<C>::max();
+
+	static void encode(vector<uint8_t>& stream, unsigned x) {
+		while (x >= 0x80) {
+			stream.push_back(static_cast<uint8_t>(x | 0x80));
+			x >>= 7;
+		}
+		stream.push_back(static_cast<uint8_t>(x));
+	}
+
+	static unsigned decode(uint8_t const*& data) {
+		unsigned x = 0;
+		for (int shift = 0;; shift += 7) {
+			uint8_t b = *data++;
+			x |= static_cast<unsigned>(b & 0x7f) << shift;
+			if (b < 0x80) {
+				return x;
+			}
+		}
+	}
+
+	// stores capacities not fitting in C aside
+	static C narrow(int p, T c, vector<pair<int, T>>& aside) {
+		if (c >= 0 && c < static_cast<T>(wide)) {
+			return static_cast<C>(c);
+		}
+		aside.emplace_back(p, c);
+		return wide;
+	}
+
+	static T widen(int p, C c, vector<pair<int, T>> const& aside) {
+		if (c != wide) {
+			return c;
+		}
+		return lower_bound(aside.begin(), aside.end(), make_pair(p, numeric_limits<T>::lowest()))->second;
+	}
+
+	void preflow() {
+		height[source] = static_cast<int>(height.size());
+		uint8_t const* data = upper.data() + upper_offset[source];
+		for (int p = upper_start[source], v = source; p < upper_start[source + 1]; p++) {
+			v += decode(data);
+			flow[p] = widen(p, capacity_up[p], wide_up);
+			excess[v] += flow[p];
+		}
+		data = lower.data() + lower_offset[source];
+		for (int v = 0, p = 0; data < lower.data() + lower_offset[source + 1];) {
+			v += decode(data);
+			p += decode(data);
+			flow[p] = -widen(p, capacity_down[p], wide_down);
+			excess[v] -= flow[p];
+		}
+	}
+
+	void normalize_edges_flow() {
+		// excess changes are gathered per vertex, so that no two threads write the same entry
+		int n = static_cast<int>(height.size());
+		#pragma omp parallel for
+		for (int u = 0; u < n; u++) {
+			T delta = 0;
+			for (int p = upper_start[u]; p < upper_start[u + 1]; p++) {
+				delta += d_flow_high[p] - d_flow_low[p];
+			}
+			uint8_t const* data = lower.data() + lower_offset[u];
+			uint8_t const* end = lower.data() + lower_offset[u + 1];
+			for (int p = 0; data < end;) {
+				decode(data);
+				p += decode(data);
+				delta += d_flow_low[p] - d_flow_high[p];
+			}
+			excess[u] += delta;
+		}
+
+		int m = pairs();
+		#pragma omp parallel for
+		for (int p = 0; p < m; p++) {
+			flow[p] += d_flow_low[p] - d_flow_high[p];
+			d_flow_low[p] = 0;
+			d_flow_high[p] = 0;
+		}
+	}
+
+	void discharge(int u) {
+		int min_height = INT_MAX, min_pair = -1;
+		T min_residual = 0;
+		bool min_up = true;
+
+		uint8_t const* data = upper.data() + upper_offset[u];
+		for (int p = upper_start[u], v = u; p < upper_start[u + 1]; p++) { // min_hood
+			v += decode(data);
+			T residual = widen(p, capacity_up[p], wide_up) - flow[p];
+			if (residual > 0 && height[v] < min_height) { // mux
+				min_height = height[v];
+				min_pair = p;
+				min_residual = residual;
+				min_up = true;
+			}
+		}
+		data = lower.data() + lower_offset[u];
+		uint8_t const* end = lower.data() + lower_offset[u + 1];
+		for (int v = 0, p = 0; data < end;) {
+			v += decode(data);
+			p += decode(data);
+			T residual = widen(p, capacity_down[p], wide_down) + flow[p];
+			if (residual > 0 && height[v] < min_height) { // mux
+				min_height = height[v];
+				min_pair = p;
+				min_residual = residual;
+				min_up = false;
+			}
+		}
+
+		if (min_pair < 0) {
+			return;
+		}
+		if (height[u] > min_height) {
+			T pushed = min(min_residual, excess[u]);
+			(min_up ? d_flow_low : d_flow_high)[min_pair] += pushed;
+		}
+		else {
+			height[u] = min_height + 1; // relabel
+		}
+	}
+
+	int source, sink;
+
+	// compressed topology
+	vector<uint8_t> upper, lower;            // varint streams of higher and lower neighbours
+	vector<size_t> upper_offset, lower_offset; // start of the streams of each vertex
+	vector<int> upper_start;                 // pairs owned by u are [upper_start[u], upper_start[u+1])
+	vector<C> capacity_up, capacity_down;    // capacity from the lower to the higher endpoint, and back
+	vector<pair<int, T>> wide_up, wide_down; // capacities not fitting in C, by pair
+
+	// mutable state
+	vector<int> height;
+	vector<T> excess;
+	vector<T> flow, d_flow_low, d_flow_high; // flow from the lower to the higher endpoint of each pair
+};
+
+#endif
@@ -0,0 +1,575 @@
+#ifndef PUSH_RELABEL_DISTRIBUTED_H
+#define PUSH_RELABEL_DISTRIBUTED_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "topology.hpp"
+
+using namespace std;
+
+// Push-relabel in synchronous rounds over a vertex partition, one OS process per part.
+// Every process owns the heights and excesses of its vertices and the arcs leaving them,
+// keeps ghost copies of the heights of the remote neighbours, and after each round exchanges
+// in batch the flow pushed along cut arcs (the d_flow_u/d_flow_v update of graph, split
+// between the two owners) and the heights of its boundary vertices that changed.
+namespace distributed {
+
+// Reports a failed system call (with the error it set) and aborts the process.
+[[noreturn]] inline void fail(char const* call) {
+	std::cerr << call << ": " << strerror(errno) << std::endl;
+	std::abort();
+}
+
+// Aborts the process if a system call failed.
+inline void check(bool ok, char const* call) {
+	if (!ok) {
+		fail(call);
+	}
+}
+
+// Aborts the process if a pthread call failed (returning its error code).
+inline void check_pthread(int error, char const* call) {
+	if (error != 0) {
+		errno = error;
+		fail(call);
+	}
+}
+
+// Writes a buffer to a file descriptor, retrying on interruptions and partial writes.
+inline void write_all(int f, void const* data, size_t size) {
+	char const* c = static_cast<char const*>(data);
+	while (size > 0) {
+		ssize_t k = write(f, c, size);
+		if (k < 0 && errno == EINTR) {
+			continue;
+		}
+		check(k > 0, "write");
+		c += k;
+		size -= k;
+	}
+}
+
+// Reads a buffer from a file descriptor, retrying on interruptions and partial reads (aborting if closed before its end).
+inline void read_all(int f, void* data, size_t size) {
+	char* c = static_cast<char*>(data);
+	while (size > 0) {
+		ssize_t k = read(f, c, size);
+		if (k < 0 && errno == EINTR) {
+			continue;
+		}
+		if (k == 0) {
+			std::cerr << "read: connection closed by peer" << std::endl;
+			std::abort();
+		}
+		check(k > 0, "read");
+		c += k;
+		size -= k;
+	}
+}
+
+// Waits for the termination of processes, returning whether all of them exited successfully: as soon
+// as one does not, the others are killed (as they may be waiting for it forever) and reaped.
+inline bool wait_processes(vector<pid_t> pids) {
+	bool ok = true;
+	while (!pids.empty()) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0 && errno == EINTR) {
+			continue;
+		}
+		check(pid > 0, "waitpid");
+		auto it = find(pids.begin(), pids.end(), pid);
+		if (it == pids.end()) {
+			continue;
+		}
+		pids.erase(it);
+		if (ok && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+			ok = false;
+			if (WIFSIGNALED(status)) {
+				std::cerr << "process " << pid << " killed by signal " << WTERMSIG(status) << std::endl;
+			}
+			else {
+				std::cerr << "process " << pid << " exited with status " << WEXITSTATUS(status) << std::endl;
+			}
+			for (pid_t other : pids) {
+				kill(other, SIGKILL);
+			}
+		}
+	}
+	return ok;
+}
+
+// Contiguous blocks of vertices of (almost) equal size.
+inline vector<int> block_partition(int n, int parts) {
+	vector<int> owner(n);
+	for (int u = 0; u < n; u++) {
+		owner[u] = static_cast<int>(static_cast<long long>(u) * parts / n);
+	}
+	return owner;
+}
+
+// Transport through a POSIX shared-memory segment: one mailbox per ordered pair of processes
+// (double-buffered across phases) and a process-shared barrier.
+class shm_transport {
+public:
+	// capacity[src * processes + dst]: maximum size of a batch from src to dst
+	shm_transport(int processes, vector<size_t> const& capacity) : processes(processes), capacity(capacity) {
+		offset.resize(capacity.size() + 1);
+		offset[0] = header_size();
+		for (size_t i = 0; i < capacity.size(); i++) {
+			offset[i + 1] = offset[i] + align(sizeof(size_t) + capacity[i]);
+		}
+		bytes = offset.back() * 2;
+
+		string name = "/push_relabel." + to_string(getpid());
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		check(fd >= 0, "shm_open");
+		check(ftruncate(fd, bytes) == 0, "ftruncate");
+		memory = static_cast<char*>(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+		check(memory != MAP_FAILED, "mmap");
+		close(fd);
+		shm_unlink(name.c_str()); // the mapping survives, and is inherited by forked processes
+
+		pthread_barrierattr_t attr;
+		check_pthread(pthread_barrierattr_init(&attr), "pthread_barrierattr_init");
+		check_pthread(pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED), "pthread_barrierattr_setpshared");
+		check_pthread(pthread_barrier_init(barrier(), &attr, processes), "pthread_barrier_init");
+		pthread_barrierattr_destroy(&attr);
+	}
+
+	~shm_transport() {
+		// the barrier is released with the mapping: destroying it would wait forever for processes
+		// killed while waiting on it
+		munmap(memory, bytes);
+	}
+
+	void attach(int r) {
+		rank = r;
+	}
+
+	// sends out[p] to every process p, and receives in[p] from it
+	void exchange(vector<vector<char>> const& out, vector<vector<char>>& in) {
+		for (int p = 0; p < processes; p++) {
+			if (p == rank) {
+				continue;
+			}
+			char* box = mailbox(rank, p);
+			size_t size = out[p].size();
+			assert(size <= capacity[rank * processes + p]);
+			memcpy(box, &size, sizeof(size_t));
+			memcpy(box + sizeof(size_t), out[p].data(), size);
+		}
+		wait_barrier();
+		for (int p = 0; p < processes; p++) {
+			if (p == rank) {
+				continue;
+			}
+			char* box = mailbox(p, rank);
+			size_t size;
+			memcpy(&size, box, sizeof(size_t));
+			in[p].assign(box + sizeof(size_t), box + sizeof(size_t) + size);
+		}
+		parity = 1 - parity;
+	}
+
+	// sum of the values of all processes
+	template <typename V>
+	V all_reduce(V value) {
+		static_assert(sizeof(V) <= slot_size, "value too large for a reduction slot");
+		char* slots = memory + align(sizeof(pthread_barrier_t)) + parity * processes * slot_size;
+		memcpy(slots + rank * slot_size, &value, sizeof(V));
+		wait_barrier();
+		V total = 0;
+		for (int p = 0; p < processes; p++) {
+			memcpy(&value, slots + p * slot_size, sizeof(V));
+			total += value;
+		}
+		parity = 1 - parity;
+		return total;
+	}
+
+private:
+	static constexpr size_t slot_size = 16;
+
+	static size_t align(size_t n) {
+		return (n + 63) / 64 * 64;
+	}
+
+	size_t header_size() const {
+		return align(sizeof(pthread_barrier_t)) + align(2 * processes * slot_size);
+	}
+
+	pthread_barrier_t* barrier() {
+		return reinterpret_cast<pthread_barrier_t*>(memory);
+	}
+
+	void wait_barrier() {
+		int r = pthread_barrier_wait(barrier());
+		if (r != PTHREAD_BARRIER_SERIAL_THREAD) {
+			check_pthread(r, "pthread_barrier_wait");
+		}
+	}
+
+	char* mailbox(int src, int dst) {
+		return memory + parity * offset.back() + offset[src * processes + dst];
+	}
+
+	int processes, rank = 0, parity = 0;
+	vector<size_t> capacity, offset;
+	size_t bytes;
+	char* memory;
+};
+
+// Transport through Unix-domain socket pairs, one per pair of processes.
+class socket_transport {
+public:
+	socket_transport(int processes, vector<size_t> const&) : processes(processes), fd(processes * processes, -1) {
+		for (int i = 0; i < processes; i++) {
+			for (int j = i + 1; j < processes; j++) {
+				int sv[2];
+				check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "socketpair");
+				fd[i * processes + j] = sv[0];
+				fd[j * processes + i] = sv[1];
+			}
+		}
+	}
+
+	~socket_transport() {
+		for (int f : fd) {
+			if (f >= 0) {
+				close(f);
+			}
+		}
+	}
+
+	void attach(int r) {
+		rank = r;
+		// keep only the endpoints of this process
+		for (int i = 0; i < processes; i++) {
+			for (int j = 0; j < processes; j++) {
+				if (i != rank && fd[i * processes + j] >= 0) {
+					close(fd[i * processes + j]);
+					fd[i * processes + j] = -1;
+				}
+			}
+		}
+	}
+
+	// sends out[p] to every process p, and receives in[p] from it
+	void exchange(vector<vector<char>> const& out, vector<vector<char>>& in) {
+		// pairwise blocking exchanges in increasing peer order cannot deadlock
+		for (int p = 0; p < processes; p++) {
+			if (p == rank) {
+				continue;
+			}
+			int f = fd[rank * processes + p];
+			if (rank < p) {
+				send(f, out[p]);
+				receive(f, in[p]);
+			}
+			else {
+				receive(f, in[p]);
+				send(f, out[p]);
+			}
+		}
+	}
+
+	// sum of the values of all processes
+	template <typename V>
+	V all_reduce(V value) {
+		vector<vector<char>> out(processes, vector<char>(sizeof(V))), in(processes);
+		for (int p = 0; p < processes; p++) {
+			memcpy(out[p].data(), &value, sizeof(V));
+		}
+		exchange(out, in);
+		V total = value;
+		for (int p = 0; p < processes; p++) {
+			if (p != rank) {
+				memcpy(&value, in[p].data(), sizeof(V));
+				total += value;
+			}
+		}
+		return total;
+	}
+
+private:
+	static void send(int f, vector<char> const& data) {
+		size_t size = data.size();
+		write_all(f, &size, sizeof(size_t));
+		write_all(f, data.data(), size);
+	}
+
+	static void receive(int f, vector<char>& data) {
+		size_t size;
+		read_all(f, &size, sizeof(size_t));
+		data.resize(size);
+		read_all(f, data.data(), size);
+	}
+
+	int processes, rank = 0;
+	vector<int> fd;
+};
+
+// Synchronous-rounds push-relabel (as in basic_graph<policy::rounds>) over partitioned processes.
+template <typename transport, typename T = long long>
+class partitioned_graph {
+	// flow pushed along a cut arc, applied by the owner of its reverse
+	struct flow_delta {
+		int arc;
+		T flow;
+	};
+	// new height of a boundary vertex
+	struct height_update {
+		int vertex;
+		int height;
+	};
+
+public:
+	partitioned_graph(topology<T> const& t, vector<int> owner, int processes)
+	: t(t), owner(move(owner)), processes(processes) {}
+
+	// runs the processes (the caller waiting for them), and returns the maximum flow value (unless failed)
+	T get_max_flow() {
+		int n = t.size();
+		int m = static_cast<int>(t.head.size());
+		height.assign(n, 0);
+		excess.assign(n, 0);
+		flow.assign(m, 0);
+		d_flow_u.assign(m, 0);
+		d_flow_v.assign(m, 0);
+
+		// preflow
+		height[t.source] = n;
+		for (int a = t.start[t.source]; a < t.start[t.source + 1]; a++) {
+			flow[a] = t.capacity[a];
+			flow[t.reverse[a]] = -t.capacity[a];
+			excess[t.head[a]] += t.capacity[a];
+		}
+
+		// cut arcs and boundary vertices towards every process
+		cut_arcs.assign(processes, {});
+		boundary.assign(processes * processes, {});
+		vector<size_t> capacity(processes * processes, 0);
+		for (int u = 0; u < n; u++) {
+			for (int a = t.start[u]; a < t.start[u + 1]; a++) {
+				int p = owner[u], q = owner[t.head[a]];
+				if (p != q) {
+					cut_arcs[p].push_back(a);
+					vector<int>& b = boundary[p * processes + q];
+					if (b.empty() || b.back() != u) {
+						b.push_back(u);
+					}
+				}
+			}
+		}
+		for (int p = 0; p < processes; p++) {
+			for (int a : cut_arcs[p]) {
+				capacity[p * processes + owner[t.head[a]]] += sizeof(flow_delta);
+			}
+			for (int q = 0; q < processes; q++) {
+				capacity[p * processes + q] += 2 * sizeof(size_t) + boundary[p * processes + q].size() * sizeof(height_update);
+			}
+		}
+
+		transport channel(processes, capacity);
+		// the result of the first process, with its bytes sent and rounds
+		int result_pipe[2];
+		check(pipe(result_pipe) == 0, "pipe");
+		std::cout.flush();
+		std::cerr.flush();
+		vector<pid_t> children;
+		for (int r = 0; r < processes; r++) {
+			pid_t pid = fork();
+			if (pid < 0) {
+				for (pid_t child : children) {
+					kill(child, SIGKILL);
+				}
+				fail("fork");
+			}
+			if (pid == 0) {
+				close(result_pipe[0]);
+				channel.attach(r);
+				T result = run(r, channel);
+				if (r == 0) {
+					write_all(result_pipe[1], &result, sizeof(T));
+					write_all(result_pipe[1], &bytes_sent, sizeof(size_t));
+					write_all(result_pipe[1], &rounds, sizeof(int));
+				}
+				_exit(0);
+			}
+			children.push_back(pid);
+		}
+		close(result_pipe[1]);
+		T result = 0;
+		failed = !wait_processes(children);
+		if (!failed) {
+			read_all(result_pipe[0], &result, sizeof(T));
+			read_all(result_pipe[0], &bytes_sent, sizeof(size_t));
+			read_all(result_pipe[0], &rounds, sizeof(int));
+		}
+		close(result_pipe[0]);
+		return result;
+	}
+
+	// bytes exchanged by the first process (ghost heights and flow deltas)
+	size_t bytes_sent = 0;
+	// number of synchronous rounds performed
+	int rounds = 0;
+	// whether a process terminated abnormally (the others being killed)
+	bool failed = false;
+
+private:
+	T run(int rank, transport& channel) {
+		int n = t.size();
+		vector<int> owned;
+		for (int u = 0; u < n; u++) {
+			if (owner[u] == rank) {
+				owned.push_back(u);
+			}
+		}
+		vector<int> sent_height(height);
+		vector<vector<char>> out(processes), in(processes);
+
+		long long remaining = 1;
+		while (remaining > 0) {
+			remaining = 0;
+			for (int u : owned) {
+				if (u != t.source && u != t.sink && excess[u] > 0) {
+					remaining++;
+					discharge(u);
+				}
+			}
+
+			// batch of flow deltas and changed heights for every other process
+			for (vector<char>& o : out) {
+				o.clear();
+			}
+			for (int a : cut_arcs[rank]) {
+				if (d_flow_u[a] != 0) {
+					append(out[owner[t.head[a]]], flow_delta{t.reverse[a], d_flow_u[a]});
+				}
+			}
+			for (int q = 0; q < processes; q++) {
+				size_t deltas = out[q].size() / sizeof(flow_delta);
+				vector<char> batch(sizeof(size_t));
+				memcpy(batch.data(), &deltas, sizeof(size_t));
+				batch.insert(batch.end(), out[q].begin(), out[q].end());
+				for (int u : boundary[rank * processes + q]) {
+					if (height[u] != sent_height[u]) {
+						append(batch, height_update{u, height[u]});
+					}
+				}
+				out[q] = move(batch);
+				if (rank == 0 && q != rank) {
+					bytes_sent += out[q].size();
+				}
+			}
+			channel.exchange(out, in);
+
+			normalize_edges_flow(owned);
+			for (int u : owned) {
+				sent_height[u] = height[u];
+			}
+			for (int p = 0; p < processes; p++) {
+				if (p == rank) {
+					continue;
+				}
+				char const* data = in[p].data();
+				size_t deltas;
+				memcpy(&deltas, data, sizeof(size_t));
+				data += sizeof(size_t);
+				for (size_t i = 0; i < deltas; i++, data += sizeof(flow_delta)) {
+					flow_delta d;
+					memcpy(&d, data, sizeof(flow_delta));
+					flow[d.arc] -= d.flow;
+					excess[t.head[t.reverse[d.arc]]] += d.flow;
+				}
+				for (; data < in[p].data() + in[p].size(); data += sizeof(height_update)) {
+					height_update h;
+					memcpy(&h, data, sizeof(height_update));
+					height[h.vertex] = h.height; // ghost copy
+				}
+			}
+			remaining = channel.all_reduce(remaining);
+			rounds++;
+		}
+		return channel.all_reduce(owner[t.sink] == rank ? excess[t.sink] : T(0));
+	}
+
+	template <typename M>
+	static void append(vector<char>& v, M const& message) {
+		char const* data = reinterpret_cast<char const*>(&message);
+		v.insert(v.end(), data, data + sizeof(M));
+	}
+
+	void normalize_edges_flow(vector<int> const& owned) {
+		for (int u : owned) {
+			for (int a = t.start[u]; a < t.start[u + 1]; a++) {
+				flow[a] += d_flow_u[a] + d_flow_v[a];
+				excess[u] -= d_flow_u[a];
+				if (owner[t.head[a]] == owner[u]) {
+					excess[t.head[a]] += d_flow_u[a];
+				}
+				d_flow_u[a] = 0;
+				d_flow_v[a] = 0;
+			}
+		}
+	}
+
+	void discharge(int u) {
+		int min_height = INT_MAX, min_arc = -1;
+
+		for (int a = t.start[u]; a < t.start[u + 1]; a++) { // min_hood
+			if (t.capacity[a] - flow[a] > 0 && height[t.head[a]] < min_height) { // mux
+				min_height = height[t.head[a]];
+				min_arc = a;
+			}
+		}
+
+		if (min_arc < 0) {
+			return;
+		}
+		if (height[u] > min_height) {
+			T f = min(t.capacity[min_arc] - flow[min_arc], excess[u]);
+			d_flow_u[min_arc] += f;
+			if (owner[t.head[min_arc]] == owner[u]) {
+				d_flow_v[t.reverse[min_arc]] -= f;
+			}
+		}
+		else {
+			height[u] = min_height + 1; // relabel
+		}
+	}
+
+	topology<T> const& t;
+	vector<int> owner;
+	int processes;
+
+	vector<int> height;    // owned vertices, and ghost copies of remote neighbours
+	vector<T> excess;      // owned vertices
+	vector<T> flow, d_flow_u, d_flow_v; // arcs leaving owned vertices
+	vector<vector<int>> cut_arcs;       // arcs leaving each process
+	vector<vector<int>> boundary;       // vertices of a process adjacent to another process
+};
+
+}
+
+#endif
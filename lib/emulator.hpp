@@ -0,0 +1,288 @@
+#ifndef PUSH_RELABEL_EMULATOR_H
+#define PUSH_RELABEL_EMULATOR_H
+
+#include <cassert>
+#include <climits>
+#include <cstdint>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "scenario.hpp"
+
+using namespace std;
+
+// Bulk-synchronous emulation of the aggregate algorithm (as in lib/aggregate.hpp, with synchronous
+// rounds and no variant but the push rule), over the symmetric topology of devices 1..n in CSR
+// form. Every device applies the same rule of the fused kernel in every round, reading the flows
+// and heights its neighbours exported in the previous round and writing its own to the other of two
+// buffers: arc a from u to v holds the packed flow (with its priority) u exports towards v, and
+// rev[a] is the arc from v to u. In the first round no neighbour has been heard from yet, so that
+// neighbour values (all zero) take part in the rule but not in excess, lowest neighbour and clamp.
+// This assumes that synchronous rounds of the simulator only read exports of previous rounds, as
+// checked against rows streamed by batch runs in run/emulator.cpp.
+class bulk_emulator {
+public:
+	bulk_emulator(vector<tuple<int, int, long long>> const& arcs, int n_nodes, bool multi_push = false)
+	: n(n_nodes), multi_push(multi_push) {
+		// merged capacities, with an arc (possibly of no capacity) in both directions
+		map<pair<int, int>, long long> merged;
+		for (auto const& a : arcs) {
+			int u = get<0>(a), v = get<1>(a);
+			if (u == v || u < 1 || v < 1 || u > n || v > n) {
+				continue;
+			}
+			merged[{u, v}] += get<2>(a);
+			merged[{v, u}] += 0;
+		}
+		start.assign(n + 1, 0);
+		for (auto const& x : merged) {
+			start[x.first.first]++;
+		}
+		for (int u = 1; u <= n; u++) {
+			start[u] += start[u - 1];
+		}
+		for (auto const& x : merged) {
+			head.push_back(x.first.second - 1);
+			capacity.push_back(x.second);
+		}
+		rev.resize(head.size());
+		for (int u = 0; u < n; u++) {
+			for (int a = start[u]; a < start[u + 1]; a++) {
+				rev[a] = arc(head[a], u);
+			}
+		}
+		for (int b = 0; b < 2; b++) {
+			packed[b].assign(head.size(), 0);
+			height[b].assign(n, 0);
+		}
+		flow.resize(head.size());
+		priority.resize(head.size());
+		residual.resize(head.size());
+		admissible.resize(head.size());
+		new_flow.resize(head.size());
+		e_flow.assign(n, 0);
+	}
+
+	// the arc from u to v (by index), or -1 if not adjacent
+	int arc(int u, int v) const {
+		auto first = head.begin() + start[u], last = head.begin() + start[u + 1];
+		auto it = lower_bound(first, last, v);
+		return it != last && *it == v ? static_cast<int>(it - head.begin()) : -1;
+	}
+
+	// Sets the capacity of the arc from device u to device v, returning whether they are adjacent.
+	bool set_capacity(int u, int v, long long c) {
+		int a = u >= 1 && v >= 1 && u <= n && v <= n ? arc(u - 1, v - 1) : -1;
+		if (a >= 0) {
+			capacity[a] = c;
+		}
+		return a >= 0;
+	}
+
+	// Sets the capacity changes of every state of a scenario up to the i-th (not already set).
+	void update(scenario const& s, int i) {
+		for (int j = applied + 1; j <= i; j++) {
+			for (int u = 1; u <= n; u++) {
+				auto changed = s.changed(j, u);
+				for (auto a = changed.first; a != changed.second; a++) {
+					set_capacity(get<0>(*a), get<1>(*a), get<2>(*a));
+				}
+			}
+		}
+		applied = max(applied, i);
+	}
+
+	// Runs a round of every device in the i-th state of a scenario (whose capacity changes must be already set).
+	void round(scenario const& s, int i) {
+		int c = current, x = 1 - current;
+		bool heard = rounds > 0;
+
+		#pragma omp parallel for
+		for (int u = 0; u < n; u++) {
+			step(u, s.is_source(i, u + 1), s.is_sink(i, u + 1), heard, packed[c], height[c], packed[x], height[x]);
+		}
+		current = x;
+		rounds++;
+	}
+
+	// Runs rounds at times 1/2, 3/2... up to a given end, applying the capacity changes of every state of
+	// the scenario once reached, and returning the total excess of sinks after every round.
+	vector<long long> run(scenario const& s, double end) {
+		vector<long long> sink_flow;
+		for (double t = 0.5; t <= end; t += 1) {
+			int state = s.at(t);
+			update(s, state);
+			round(s, state);
+			long long total = 0;
+			#pragma omp parallel for reduction(+:total)
+			for (int u = 0; u < n; u++) {
+				if (s.is_sink(state, u + 1)) {
+					total += e_flow[u];
+				}
+			}
+			sink_flow.push_back(total);
+		}
+		return sink_flow;
+	}
+
+	int size() const {
+		return n;
+	}
+
+	int arcs() const {
+		return static_cast<int>(head.size());
+	}
+
+	// excess and height of device u (by index) after the last round
+	long long excess(int u) const {
+		return e_flow[u];
+	}
+
+	int get_height(int u) const {
+		return height[current][u];
+	}
+
+private:
+	// packing of flows and priorities, as in lib/aggregate.hpp
+	static long long pack_flow(long long flow, int priority) {
+		assert(flow >= -LLONG_MAX / 4 && flow <= LLONG_MAX / 4 && priority >= 0 && priority < 4);
+		return flow * 4 + priority;
+	}
+
+	static int unpack_priority(long long packed) {
+		return static_cast<int>((packed % 4 + 4) % 4);
+	}
+
+	static long long unpack_flow(long long packed) {
+		return (packed - unpack_priority(packed)) / 4;
+	}
+
+	// a round of device u, from the exports of the previous round (in) to the ones of this round (out)
+	void step(int u, bool is_source, bool is_sink, bool heard, vector<long long> const& in, vector<int> const& height_in, vector<long long>& out, vector<int>& height_out) {
+		int first = start[u], last = start[u + 1];
+
+		// priority handshake and clamps, summing the excess
+		int old_height = height_in[u], h = old_height;
+		if (is_sink) h = 0;
+		if (is_source) h = n;
+		long long sum = 0;
+		for (int a = first; a < last; a++) {
+			int v = head[a];
+			long long f = -unpack_flow(in[rev[a]]);
+			int p = unpack_priority(in[rev[a]]);
+			long long of = unpack_flow(in[a]);
+			int op = unpack_priority(in[a]);
+			if (p == op && op == 2 && f != of) {
+				if (u >= v) of = f;
+				f = of;
+				p = 2;
+			}
+			else if (f != of && old_height + 1 != height_in[v] && p == 1) {
+				f = of;
+				p = 2;
+			}
+			else {
+				p = 0;
+			}
+			if (is_sink) f = min(f, 0ll);
+			if (is_source) f = height_in[v] < h ? capacity[a] : max(f, 0ll);
+			f = min(f, capacity[a]);
+			flow[a] = f;
+			priority[a] = p;
+			if (heard) sum += f;
+		}
+		long long e = -sum;
+
+		// excess limiting (in order of neighbours) and lowest residual neighbour
+		bool limit = !is_source && e < 0;
+		int min_height = INT_MAX, min_uid = INT_MAX;
+		for (int a = first; a < last; a++) {
+			if (limit && flow[a] > 0) {
+				long long r = min(-e, flow[a]);
+				flow[a] -= r;
+				e -= r;
+			}
+			residual[a] = capacity[a] - flow[a];
+			if (heard && residual[a] > 0 && make_pair(height_in[head[a]], head[a]) < make_pair(min_height, min_uid)) {
+				min_height = height_in[head[a]];
+				min_uid = head[a];
+			}
+		}
+		if (min_height >= h && e > 0 && !is_source && !is_sink) {
+			h = min_height + 1; // relabel
+		}
+
+		// pushes, height clamp and packing
+		bool push = !is_source && !is_sink && e > 0;
+		for (int a = first; a < last; a++) {
+			new_flow[a] = 0;
+		}
+		if (push && multi_push) {
+			long long total = 0;
+			for (int a = first; a < last; a++) {
+				admissible[a] = residual[a] > 0 && height_in[head[a]] < h ? residual[a] : 0;
+				new_flow[a] = admissible[a];
+				if (heard) total += admissible[a];
+			}
+			if (total > e) {
+				long long pushed = 0;
+				for (int a = first; a < last; a++) {
+					new_flow[a] = static_cast<long long>(static_cast<__int128>(admissible[a]) * e / total);
+					if (heard) pushed += new_flow[a];
+				}
+				long long rest = e - pushed;
+				for (int a = first; a < last; a++) {
+					long long d = min(rest, admissible[a] - new_flow[a]);
+					rest -= d;
+					new_flow[a] += d;
+				}
+			}
+		}
+		int new_height = h;
+		for (int a = first; a < last; a++) {
+			int v = head[a];
+			if (push && !multi_push && v == min_uid && h >= min_height + 1) {
+				new_flow[a] = min(residual[a], e);
+			}
+			if (push && new_flow[a] > 0) {
+				priority[a] = 1;
+			}
+			if (heard && residual[a] > 0 && height_in[v] + 1 < h) {
+				new_height = min(new_height, height_in[v]);
+			}
+			out[a] = pack_flow(flow[a] + new_flow[a], priority[a]);
+		}
+		height_out[u] = new_height;
+		e_flow[u] = e;
+	}
+
+	int n;
+	bool multi_push;
+
+	// topology
+	vector<int> start; // the arcs of device u (by index) are [start[u], start[u+1]), sorted by head
+	vector<int> head, rev;
+	vector<long long> capacity;
+
+	// exports of the last round (current) and of the next one, per arc and per device
+	vector<long long> packed[2];
+	vector<int> height[2];
+	int current = 0;
+	int rounds = 0;
+	int applied = -1; // last state of the scenario whose capacity changes are set
+
+	// per-arc scratch (disjoint between devices) and excess of devices
+	vector<long long> flow, residual, admissible, new_flow;
+	vector<int> priority;
+	vector<long long> e_flow;
+};
+
+#endif
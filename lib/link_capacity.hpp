@@ -0,0 +1,45 @@
+#ifndef PUSH_RELABEL_LINK_CAPACITY_H
+#define PUSH_RELABEL_LINK_CAPACITY_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+// Capacity of a link as a function of its length, tabulated at regular lengths up to the
+// communication range and interpolated linearly in logarithmic scale (capacities span many
+// orders of magnitude). Links shorter than the first sample get its capacity, longer than the
+// range get none.
+class link_capacity_table {
+public:
+	template <typename F>
+	link_capacity_table(F capacity, double range, int samples = 4096) : range(range), step(range / samples) {
+		log_capacity.resize(samples + 1);
+		for (int i = 0; i <= samples; i++) {
+			double c = capacity(max(i, 1) * step);
+			c = min(max(c, numeric_limits<double>::min()), numeric_limits<double>::max());
+			log_capacity[i] = log(c);
+		}
+		log_capacity[0] = log_capacity[1];
+	}
+
+	double operator()(double distance) const {
+		if (!(distance <= range)) {
+			return 0;
+		}
+		double x = max(distance, 0.0) / step;
+		size_t i = min(static_cast<size_t>(x), log_capacity.size() - 2);
+		double t = x - i;
+		return exp(log_capacity[i] + t * (log_capacity[i + 1] - log_capacity[i]));
+	}
+
+	double const range;
+
+private:
+	double const step;
+	vector<double> log_capacity;
+};
+
+#endif
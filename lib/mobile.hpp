@@ -0,0 +1,178 @@
+// Copyright © 2021 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file mobile.hpp
+ * @brief Aggregate Push-Relabel algorithm on mobile devices, with capacities of links from their length.
+ */
+
+#ifndef PUSH_RELABEL_MOBILE_H
+#define PUSH_RELABEL_MOBILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//! Importing the FCPP library.
+#include "lib/fcpp.hpp"
+//! Importing the link capacity table.
+#include "lib/link_capacity.hpp"
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+//! @brief Dummy ordering between positions (allows positions to be used as secondary keys in ordered tuples).
+template <size_t n>
+bool operator<(vec<n> const&, vec<n> const&) {
+    return false;
+}
+
+//! @brief Probability (percentage) of failure of a link at the communication radius.
+constexpr int fail_probability = 90;
+//! @brief Radius of communication.
+constexpr int radius = 250;
+//! @brief Change in the length of a link after which its capacity is recomputed.
+constexpr double capacity_tolerance = 1;
+//! @brief Maximum relative capacity of a link (for links much shorter than the radius).
+constexpr double max_capacity = 1000;
+
+namespace coordination {
+//! @brief The maximum communication range between nodes.
+constexpr size_t communication_range = 1;
+
+//! @brief Aggregate Push-Relabel algorithm with real-valued capacities, calculating excess flow and height of nodes.
+FUN tuple<double, int> aggregate_push_relabel(ARGS, bool is_source, bool is_sink, field<double> const& capacity, int node_num) { CODE
+    double e_flow = 0;
+    int height = 0;
+    tuple<field<double>, int, int> init(0, 0, 0);
+    
+    nbr(CALL, init, [&](field<tuple<double, int, int>> flow_height){
+        field<double> new_flow = 0;
+
+        field<double> flow = -get<0>(flow_height);
+        field<int> nbr_height = get<1>(flow_height);
+        field<int> nbr_priority = get<2>(flow_height);
+
+        height = get<1>(self(CALL, flow_height));
+        field<bool> neigh_is_source = nbr(CALL, is_source);
+        
+        tuple<field<double>, field<int>> o_flow(flow, nbr_priority);
+
+        o_flow = old(CALL, o_flow, [&](field<tuple<double, int>> old_values){
+            field<double> old_flow = get<0>(old_values);
+            field<int> old_priority = get<1>(old_values);
+
+            field<tuple<double, int>> temp = map_hood([&](double f, double of, int priority, int h, int op, int uids){
+                if(priority == op and op == 2 and f != of){
+                    if(node.uid < uids){
+                        return make_tuple(of, 2);
+                    }
+                    return make_tuple(f, 2);
+                }
+
+                if(f != of and height + 1 != h and priority == 1){
+                    return make_tuple(of, 2);
+                } else{
+                    return make_tuple(f, 0);
+                }
+            }, flow, old_flow, nbr_priority, nbr_height, old_priority, nbr_uid(CALL));
+
+            flow = get<0>(temp);
+            nbr_priority = get<1>(temp);
+
+            if (is_sink) {
+                height = 0;
+                flow = mux(flow > 0, .0, flow);
+            }
+            if (is_source) {
+                height = node_num;
+                flow = mux(nbr_height < height, capacity, mux(flow < 0, .0, flow));
+            }
+
+            flow = mux(flow > capacity, capacity, flow);
+            e_flow = -sum_hood(CALL, flow, 0);
+
+            // if a node is giving away more flow than it receives, stop giving excess (variant to try: reduce outgoing edges proportionally)
+            if (not is_source and e_flow < 0) {
+                flow = map_hood([&](double f, int priority){
+                    if (f > 0) {
+                        double r = min(-e_flow, f);
+                        f -= r;
+                        e_flow -= r;
+                    }
+                    return f;
+                }, flow, nbr_priority);
+            }
+            
+            field<double> res_capacity = capacity - flow;
+
+            field<int> neighs = nbr_uid(CALL);
+            tuple<int, int> min_height = min_hood(CALL, mux(res_capacity > 0 and neighs != node.uid, make_tuple(nbr_height, neighs), make_tuple(INT_MAX, INT_MAX)));
+
+            if (get<0>(min_height) >= height and e_flow > 0 and not is_source and not is_sink) {
+                assert(min_height != make_tuple(INT_MAX, INT_MAX));
+                height = get<0>(min_height) + 1; // Relabel
+            }
+            
+            if (not is_source and not is_sink and e_flow > 0){
+                new_flow = mux(get<1>(min_height) == neighs and height >= get<0>(min_height) + 1, min(res_capacity, e_flow), (double)0);
+                nbr_priority = mux(new_flow > 0, 1, nbr_priority);
+            }
+
+            height = min_hood(CALL, mux(res_capacity > 0 and nbr_height + 1 < height, nbr_height, height));
+            return make_tuple(flow + new_flow, nbr_priority);
+        });
+        flow = get<0>(o_flow);
+        return make_tuple(flow, height, nbr_priority);
+    });
+    
+    return make_tuple(e_flow, height);
+}
+//! @brief Export types used by the aggregate_push_relabel function.
+FUN_EXPORT aggregate_push_relabel_t = export_list<tuple<field<double>, int, field<int>>, field<bool>, tuple<field<double>, field<int>>>;
+
+
+//! @brief Capacity of a link of a given length.
+//using position_type = vec<fcpp::component::tags::dimension>;
+inline double get_capacity(double distance){
+    double p = fail_probability / 100.0;
+    double e = (double)pow((7*exp((p - (radius/distance) * log(6792093.0/29701))/(1-p) + 1)), (double)-1/3);
+    return e;
+}
+
+//! @brief Capacity of a link of a given length, relative to one of length radius (saturated at max_capacity).
+inline double get_relative_capacity(double distance){
+    return std::min(get_capacity(distance) / get_capacity(radius), max_capacity);
+}
+
+//! @brief Capacities of links from their length (looked up in a table), recomputed only for links whose length changed by more than capacity_tolerance.
+FUN field<double> link_capacities(ARGS, field<bool> const& connected, link_capacity_table const& table) { CODE
+    // length of every link when its capacity was last computed (none if not connected), and the capacity
+    tuple<double, double> const none(-std::numeric_limits<double>::infinity(), 0);
+    field<tuple<double, double>> links = old(CALL, field<tuple<double, double>>(none), [&](field<tuple<double, double>> const& o){
+        return map_hood([&](tuple<double, double> const& l, double dist, bool conn){
+            if (not conn) return none;
+            if (abs(get<0>(l) - dist) <= capacity_tolerance) return l;
+            return make_tuple(dist, table(dist));
+        }, o, node.nbr_dist(), connected);
+    });
+    return get<1>(links);
+}
+//! @brief The table of capacities of links from their length given by get_relative_capacity (raw capacities of short links overflow the double push-relabel), shared by devices and oracles.
+inline link_capacity_table const& relative_capacity_table() {
+    static link_capacity_table const table(get_relative_capacity, radius);
+    return table;
+}
+//! @brief Capacities of links from their length, as given by the relative capacity table.
+FUN field<double> link_capacities(ARGS, field<bool> const& connected) { CODE
+    return link_capacities(CALL, connected, relative_capacity_table());
+}
+//! @brief Export types used by the link_capacities function.
+FUN_EXPORT link_capacities_t = export_list<field<tuple<double, double>>>;
+
+} // namespace coordination
+
+} // namespace fcpp
+
+#endif
@@ -3,48 +3,79 @@
 
 #include <cassert>
 #include <climits>
+#include <cmath>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "topology.hpp"
+
 using namespace std;
 
-struct edge;
+// Compile-time policies selecting the algorithm variant run by basic_graph.
+namespace policy {
+	// vertex selection rules
+	struct rounds {};        // synchronous parallel rounds over all active vertices
+	struct fifo {};          // sequential, active vertices discharged in FIFO order
+	struct highest_label {}; // sequential, active vertex of maximum height first
+
+	// discharge strategies
+	struct single_push {};    // a single push or relabel per selection
+	struct full_discharge {}; // push until the excess is exhausted (in rounds: along every admissible arc)
+
+	// relabel heuristics
+	template <bool global, bool gap>
+	struct heuristics {
+		static constexpr bool global_relabel = global; // exact labels by backward BFS from the sink
+		static constexpr bool gap_relabel = gap;       // lift vertices above an empty height level
+	};
+	using no_heuristics = heuristics<false, false>;
+}
+
+template <typename T>
+struct basic_edge;
 
-struct node {
+template <typename T>
+struct basic_node {
 	int id;
+	int index = -1; // position in the graph
 	int height;
-	long long e_flow; // excess flow
-	vector<edge*> neighbors;
+	T e_flow; // excess flow
+	bool active = false;
+	vector<basic_edge<T>*> neighbors;
 
-	node(int id) {
+	basic_node(int id) {
 		this->id = id;
 		this->height = 0;
 		this->e_flow = 0;
 	}
 
-	node(int id, int height, long long int e_flow) {
+	basic_node(int id, int height, T e_flow) {
 		this->id = id;
 		this->height = height;
 		this->e_flow = e_flow;
 	}
 };
 
-struct edge {
-	node* u;
-	node* v;
-	long long int capacity;
-	long long flow = 0, d_flow_u = 0, d_flow_v = 0;
+template <typename T>
+struct basic_edge {
+	basic_node<T>* u;
+	basic_node<T>* v;
+	T capacity;
+	T flow = 0, d_flow_u = 0, d_flow_v = 0;
 
-	edge(node* u, node* v, long long int capacity, long long int flow = 0) {
+	basic_edge(basic_node<T>* u, basic_node<T>* v, T capacity, T flow = 0) {
 		this->capacity = capacity;
 		this->flow = flow;
 		this->u = u;
@@ -53,18 +84,74 @@ struct edge {
 	}
 };
 
-class graph {
-	vector<node*> nodes;
-	vector<edge*> edges;
+// Outcome of the optimality check of a computed flow.
+template <typename T>
+struct flow_certificate {
+	bool capacity = true;     // no arc carries more than its capacity
+	bool skew = true;         // opposite arcs carry opposite flows
+	bool conservation = true; // inflow equals outflow at every non-terminal vertex
+	bool separated = true;    // the sink is not reachable in the residual graph
+	T flow = 0;               // net flow leaving the source
+	T cut = 0;                // capacity of the cut around the residual-reachable set of the source
+
+	explicit operator bool() const {
+		if constexpr (is_floating_point<T>::value) {
+			return capacity && skew && conservation && separated && abs(flow - cut) <= 1e-9 * max(abs(cut), T(1));
+		}
+		else {
+			return capacity && skew && conservation && separated && flow == cut;
+		}
+	}
+};
+
+template <typename selection = policy::rounds, typename discharge_policy = policy::single_push, typename heuristics = policy::no_heuristics, typename T = long long>
+class basic_graph {
+public:
+	using value_type = T;
+	using node_type = basic_node<T>;
+	using edge_type = basic_edge<T>;
+
+private:
+	static constexpr bool in_rounds = is_same<selection, policy::rounds>::value;
+	static constexpr bool full = is_same<discharge_policy, policy::full_discharge>::value;
+
+	vector<node_type*> nodes;
+	vector<edge_type*> edges;
+
+	node_type* source_node = nullptr;
+	node_type* sink_node = nullptr;
+
+	// active vertices of the sequential selection rules
+	deque<node_type*> fifo_queue;
+	vector<vector<node_type*>> buckets;
+	int max_bucket = -1;
+
+	// number of vertices at each height (gap heuristic)
+	vector<int> level_count;
+	// relabels since the last global relabel
+	long long relabels = 0;
+	// reversed residual graph in CSR form (global relabel)
+	vector<int> bfs_start, bfs_queue;
+	vector<node_type*> bfs_arcs;
+	// excess up to which a vertex is inactive with floating-point capacities (rounding residues),
+	// relative to the largest finite capacity
+	static constexpr double relative_residue = 1e-12;
+	T residue = 0;
 
 public:
-	void add_node(node* new_node) {
+	void add_node(node_type* new_node) {
+		new_node->index = static_cast<int>(nodes.size());
 		nodes.push_back(new_node);
 	}
 
-	void add_edge(node& u, node& v, long long int capacity) {
+	void add_edge(node_type& u, node_type& v, T capacity) {
+		if constexpr (is_floating_point<T>::value) {
+			if (capacity < numeric_limits<T>::max()) {
+				residue = max(residue, static_cast<T>(relative_residue * capacity));
+			}
+		}
 		bool found = false;
-		for (edge* e : u.neighbors) {
+		for (edge_type* e : u.neighbors) {
 			if (&v == e->v && e->capacity == 0) {
 				found = true;
 				e->capacity = capacity;
@@ -73,55 +160,293 @@ public:
 		}
 
 		if (!found) {
-			edges.push_back(new edge(&u, &v, capacity));
+			edges.push_back(new edge_type(&u, &v, capacity));
 		}
 
-		for (edge* e : v.neighbors) {
+		for (edge_type* e : v.neighbors) {
 			if (&u == e->v) {
 				return;
 			}
 		}
 
 		// reverse edge does not exist: add it
-		edges.push_back(new edge(&v, &u, 0, 0));
+		edges.push_back(new edge_type(&v, &u, 0, 0));
 	}
 
-	long long int get_max_flow(node& source, node& t) {
-		int remaining = 1;
+	T get_max_flow(node_type& source, node_type& t) {
+		source_node = &source;
+		sink_node = &t;
 
 		preflow(source);
+		if constexpr (heuristics::global_relabel) {
+			global_relabel();
+		}
+		if constexpr (in_rounds) {
+			run_rounds();
+		}
+		else {
+			run_sequential();
+		}
+
+		return t.e_flow;
+	}
+
+	// bytes used by vertices and arcs (including allocation headers)
+	size_t memory() const {
+		constexpr size_t header = 16;
+		size_t bytes = (nodes.size() + edges.size()) * sizeof(void*);
+		for (node_type* u : nodes) {
+			bytes += sizeof(node_type) + header + u->neighbors.capacity() * sizeof(edge_type*);
+		}
+		return bytes + edges.size() * (sizeof(edge_type) + header);
+	}
+
+	size_t edge_count() const {
+		return edges.size();
+	}
+
+	// checks in O(|V|+|E|) that the flow computed by get_max_flow is maximum
+	flow_certificate<T> certify() const {
+		flow_certificate<T> cert;
+		int n = static_cast<int>(nodes.size());
+
+		// incoming arcs of every vertex in CSR form
+		vector<int> in_start(n + 1, 0);
+		vector<edge_type*> in_arcs(edges.size());
+		for (edge_type* e : edges) {
+			in_start[e->v->index + 1]++;
+		}
+		for (int i = 0; i < n; i++) {
+			in_start[i + 1] += in_start[i];
+		}
+		vector<int> in_fill(in_start.begin(), in_start.end() - 1);
+		for (edge_type* e : edges) {
+			in_arcs[in_fill[e->v->index]++] = e;
+		}
+
+		bool capacity = true, skew = true, conservation = true;
+		T source_flow = 0, sink_flow = 0;
+
+		#pragma omp parallel
+		{
+			// net flow from the current vertex towards each neighbour
+			vector<T> net(n, 0);
+
+			#pragma omp for reduction(&&:capacity, skew, conservation) reduction(+:source_flow, sink_flow)
+			for (int i = 0; i < n; i++) {
+				node_type* u = nodes[i];
+				T out = 0;
+				for (edge_type* e : u->neighbors) {
+					capacity = capacity && e->flow <= e->capacity;
+					net[e->v->index] += e->flow;
+					out += e->flow;
+				}
+				for (int j = in_start[i]; j < in_start[i + 1]; j++) {
+					net[in_arcs[j]->u->index] += in_arcs[j]->flow;
+				}
+				for (edge_type* e : u->neighbors) {
+					skew = skew && is_zero(net[e->v->index]);
+					net[e->v->index] = 0;
+				}
+				for (int j = in_start[i]; j < in_start[i + 1]; j++) {
+					skew = skew && is_zero(net[in_arcs[j]->u->index]);
+					net[in_arcs[j]->u->index] = 0;
+				}
+				if (u == source_node) {
+					source_flow += out;
+				}
+				else if (u == sink_node) {
+					sink_flow -= out;
+				}
+				else {
+					conservation = conservation && is_zero(out);
+				}
+			}
+		}
+		cert.capacity = capacity;
+		cert.skew = skew;
+		cert.conservation = conservation && is_zero(source_flow - sink_flow);
+		cert.flow = source_flow;
+
+		// vertices reachable from the source in the residual graph
+		vector<char> reached(n, 0);
+		vector<int> queue{source_node->index};
+		reached[source_node->index] = 1;
+		for (size_t i = 0; i < queue.size(); i++) {
+			for (edge_type* e : nodes[queue[i]]->neighbors) {
+				if (e->capacity - e->flow > 0 && !reached[e->v->index]) {
+					reached[e->v->index] = 1;
+					queue.push_back(e->v->index);
+				}
+			}
+		}
+		cert.separated = !reached[sink_node->index];
+
+		T cut = 0;
+		int reached_count = static_cast<int>(queue.size());
+		#pragma omp parallel for reduction(+:cut)
+		for (int i = 0; i < reached_count; i++) {
+			for (edge_type* e : nodes[queue[i]]->neighbors) {
+				if (!reached[e->v->index]) {
+					cut += e->capacity;
+				}
+			}
+		}
+		cert.cut = cut;
+
+		return cert;
+	}
+
+private:
+	static bool is_zero(T x) {
+		if constexpr (is_floating_point<T>::value) {
+			return abs(x) <= 1e-9;
+		}
+		else {
+			return x == 0;
+		}
+	}
+
+	bool is_terminal(node_type const& u) const {
+		return &u == source_node || &u == sink_node;
+	}
+
+	// whether u has excess to discharge (ignoring rounding residues with floating-point capacities)
+	bool has_excess(node_type const& u) const {
+		if constexpr (is_floating_point<T>::value) {
+			return u.e_flow > residue;
+		}
+		else {
+			return u.e_flow > 0;
+		}
+	}
+
+	void run_rounds() {
+		int remaining = 1;
 
 		while (remaining > 0) {
 			remaining = 0;
+			long long round_relabels = 0;
 
-			#pragma omp parallel for
-			for (int i = 0; i < nodes.size(); i++) {
-				if (&source != nodes.at(i) && nodes.at(i) != &t && nodes.at(i)->e_flow > 0) {
-					#pragma omp atomic
+			int n = static_cast<int>(nodes.size());
+			#pragma omp parallel for reduction(+:remaining, round_relabels)
+			for (int i = 0; i < n; i++) {
+				if (!is_terminal(*nodes.at(i)) && has_excess(*nodes.at(i))) {
 					remaining++;
-
-					discharge(*nodes.at(i));
+					round_relabels += discharge(*nodes.at(i));
 				}
 			}
 			normalize_edges_flow();
+
+			if constexpr (heuristics::global_relabel) {
+				relabels += round_relabels;
+				if (relabels >= static_cast<long long>(nodes.size())) {
+					global_relabel();
+				}
+			}
+			// levels are only counted between rounds, once every height of the round has been written
+			if constexpr (heuristics::gap_relabel) {
+				count_levels();
+				for (int h = 1; h < n; h++) {
+					if (level_count[h] == 0) {
+						gap_relabel(h);
+						break;
+					}
+				}
+			}
 		}
+	}
 
-		return t.e_flow;
+	void run_sequential() {
+		if constexpr (heuristics::gap_relabel) {
+			count_levels();
+		}
+		activate_all();
+
+		while (node_type* u = next_active()) {
+			discharge(*u);
+			if (has_excess(*u)) {
+				activate(*u);
+			}
+			if constexpr (heuristics::global_relabel) {
+				if (relabels >= static_cast<long long>(nodes.size())) {
+					global_relabel();
+					if constexpr (heuristics::gap_relabel) {
+						count_levels();
+					}
+					activate_all();
+				}
+			}
+		}
 	}
 
-private:
-	void preflow(node& source) {
+	void activate(node_type& u) {
+		if (u.active || is_terminal(u)) {
+			return;
+		}
+		u.active = true;
+		if constexpr (is_same<selection, policy::fifo>::value) {
+			fifo_queue.push_back(&u);
+		}
+		else {
+			if (u.height >= static_cast<int>(buckets.size())) {
+				buckets.resize(u.height + 1);
+			}
+			buckets[u.height].push_back(&u);
+			max_bucket = max(max_bucket, u.height);
+		}
+	}
+
+	// (re)builds the active set after heights changed in bulk
+	void activate_all() {
+		fifo_queue.clear();
+		for (vector<node_type*>& b : buckets) {
+			b.clear();
+		}
+		max_bucket = -1;
+		for (node_type* u : nodes) {
+			u->active = false;
+			if (has_excess(*u)) {
+				activate(*u);
+			}
+		}
+	}
+
+	node_type* next_active() {
+		node_type* u = nullptr;
+		if constexpr (is_same<selection, policy::fifo>::value) {
+			if (!fifo_queue.empty()) {
+				u = fifo_queue.front();
+				fifo_queue.pop_front();
+			}
+		}
+		else {
+			while (max_bucket >= 0 && buckets[max_bucket].empty()) {
+				max_bucket--;
+			}
+			if (max_bucket >= 0) {
+				u = buckets[max_bucket].back();
+				buckets[max_bucket].pop_back();
+			}
+		}
+		if (u != nullptr) {
+			u->active = false;
+		}
+		return u;
+	}
+
+	void preflow(node_type& source) {
 		source.height = static_cast<int>(nodes.size());
-		for (edge* e : source.neighbors) {
+		for (edge_type* e : source.neighbors) {
 			e->flow = e->capacity;
 			e->v->e_flow += e->flow;
 
-			edges.push_back(new edge(e->v, e->u, 0, -e->flow));
+			edges.push_back(new edge_type(e->v, e->u, 0, -e->flow));
 		}
 	}
 	
 	void normalize_edges_flow() {
-		for (edge* e : edges) {
+		for (edge_type* e : edges) {
 			e->flow += (e->d_flow_u + e->d_flow_v);
 			e->u->e_flow -= e->d_flow_u;
 			e->v->e_flow += e->d_flow_u;
@@ -131,51 +456,188 @@ private:
 		}
 	}
 
-	void reverse_edge_flow(edge& e_param, long long int flow) {
-		for (edge* e : e_param.v->neighbors) {
+	edge_type* reverse_edge(edge_type& e_param) {
+		for (edge_type* e : e_param.v->neighbors) {
 			if (e_param.u == e->v) {
-				e->d_flow_v -= flow;
-				return;
+				return e;
 			}
 		}
+		return nullptr;
 	}
 
-	void push(edge& e) {
-		long long int flow = min(e.capacity - e.flow, e.u->e_flow);
+	// residual capacity, including the flow already pushed in the current round
+	T residual(edge_type const& e) const {
+		if constexpr (in_rounds && full) {
+			return e.capacity - e.flow - e.d_flow_u;
+		}
+		else {
+			return e.capacity - e.flow;
+		}
+	}
 
-		e.d_flow_u += flow;
+	void push(edge_type& e, T flow) {
+		if constexpr (in_rounds) {
+			e.d_flow_u += flow;
+			reverse_edge(e)->d_flow_v -= flow;
+		}
+		else {
+			e.flow += flow;
+			reverse_edge(e)->flow -= flow;
+			e.u->e_flow -= flow;
+			e.v->e_flow += flow;
+			activate(*e.v);
+		}
+	}
 
-		reverse_edge_flow(e, flow);
+	void set_height(node_type& u, int height) {
+		if constexpr (heuristics::gap_relabel && !in_rounds) {
+			int old_height = u.height;
+			if (height >= static_cast<int>(level_count.size())) {
+				level_count.resize(height + 1);
+			}
+			level_count[old_height]--;
+			level_count[height]++;
+			u.height = height;
+			if (level_count[old_height] == 0 && old_height < static_cast<int>(nodes.size())) {
+				gap_relabel(old_height);
+				activate_all();
+			}
+		}
+		else {
+			u.height = height;
+		}
 	}
 
-	void discharge(node& u) {
-		int curr_edge = 0, min_height = INT_MAX;
-		edge* min_edge = u.neighbors.at(0);
+	// returns whether u has been relabelled
+	bool discharge(node_type& u) {
+		T excess = u.e_flow;
+
+		while (excess > 0) {
+			int min_height = INT_MAX;
+			edge_type* min_edge = nullptr;
+
+			for (edge_type* e : u.neighbors) { // min_hood
+				if (residual(*e) > 0 && e->v->height < min_height) { // mux
+					min_height = e->v->height;
+					min_edge = e;
+				}
+			}
+
+			if (min_edge == nullptr) {
+				return false;
+			}
+			if (u.height > min_height) {
+				T flow = min(residual(*min_edge), excess);
+				push(*min_edge, flow);
+				excess -= flow;
+			}
+			else {
+				set_height(u, min_height + 1); // relabel
+				// in rounds, relabels are summed by the caller once the parallel round is over
+				if constexpr (heuristics::global_relabel && !in_rounds) {
+					relabels++;
+				}
+				if constexpr (in_rounds || !full) {
+					return true;
+				}
+			}
+			if constexpr (!full) {
+				return false;
+			}
+		}
+		return false;
+	}
 
-		for (edge* e : u.neighbors) { // min_hood
-			if (e->capacity - e->flow > 0 && e->v->height < min_height) { // mux
-				min_height = e->v->height;
-				min_edge = e;
+	void count_levels() {
+		level_count.assign(2 * nodes.size() + 1, 0);
+		for (node_type* u : nodes) {
+			if (u->height >= static_cast<int>(level_count.size())) {
+				level_count.resize(u->height + 1);
 			}
+			level_count[u->height]++;
 		}
+	}
 
-		if (u.height > min_height) {
-			push(*min_edge);
+	// no vertex has height h: vertices above it cannot reach the sink anymore
+	void gap_relabel(int h) {
+		int n = static_cast<int>(nodes.size());
+		for (node_type* u : nodes) {
+			if (u->height > h && u->height < n && !is_terminal(*u)) {
+				if constexpr (!in_rounds) {
+					level_count[u->height]--;
+					level_count[n + 1]++;
+				}
+				u->height = n + 1;
+			}
 		}
-		else {
-			u.height = min_height + 1; // relabel
+	}
+
+	// sets heights to the exact residual distance to the sink (or to the source, offset by n)
+	void global_relabel() {
+		int n = static_cast<int>(nodes.size());
+		relabels = 0;
+
+		bfs_start.assign(n + 1, 0);
+		for (edge_type* e : edges) {
+			if (e->capacity - e->flow > 0) {
+				bfs_start[e->v->index + 1]++;
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			bfs_start[i + 1] += bfs_start[i];
+		}
+		bfs_arcs.resize(bfs_start[n]);
+		bfs_queue.assign(bfs_start.begin(), bfs_start.end() - 1);
+		for (edge_type* e : edges) {
+			if (e->capacity - e->flow > 0) {
+				bfs_arcs[bfs_queue[e->v->index]++] = e->u;
+			}
 		}
 
-		min_height = INT_MAX;
+		for (node_type* u : nodes) {
+			if (!is_terminal(*u)) {
+				u->height = INT_MAX;
+			}
+		}
+		// vertices reaching the source only are labelled after all those reaching the sink
+		bfs_from(*sink_node);
+		bfs_from(*source_node);
+		for (node_type* u : nodes) {
+			if (u->height == INT_MAX) {
+				u->height = 2 * n;
+			}
+		}
+	}
+
+	void bfs_from(node_type& root) {
+		bfs_queue.clear();
+		bfs_queue.push_back(root.index);
+		for (int i = 0; i < static_cast<int>(bfs_queue.size()); i++) {
+			node_type* v = nodes[bfs_queue[i]];
+			for (int j = bfs_start[v->index]; j < bfs_start[v->index + 1]; j++) {
+				node_type* u = bfs_arcs[j];
+				if (u->height == INT_MAX) {
+					u->height = v->height + 1;
+					bfs_queue.push_back(u->index);
+				}
+			}
+		}
 	}
 };
 
+using node = basic_node<long long>;
+using edge = basic_edge<long long>;
+using graph = basic_graph<>;
 
 namespace tests {
 
-    inline graph get_graph_from_file(string, std::unordered_map<int, node*>&);
+    template <typename G = graph>
+    inline G get_graph_from_file(string, std::unordered_map<int, typename G::node_type*>&);
     inline void test(string, int, long long);
-	long long get_flow_multiple(graph, vector<int>, vector<int>, std::unordered_map<int, node*>&);
+    template <typename G>
+	typename G::value_type get_flow_multiple(G, vector<int>, vector<int>, std::unordered_map<int, typename G::node_type*>&, bool = false);
+    template <typename G>
+	pair<typename G::node_type*, typename G::node_type*> add_terminals(G&, vector<int> const&, vector<int> const&, std::unordered_map<int, typename G::node_type*>&);
 
     inline void start_tests() {
         std::cout << "TEST START:\n";
@@ -221,19 +683,24 @@ namespace tests {
         std::unordered_map<int, node*> node_map;
         graph g = get_graph_from_file(file_name, node_map);
         assert(g.get_max_flow(*node_map[1], *node_map[last_node]) == result);
+        assert(g.certify());
     }
 
-    graph get_graph_from_file(string file_name, unordered_map<int, node*>& node_map) {
-        graph g = graph();
+    template <typename G>
+    G get_graph_from_file(string file_name, unordered_map<int, typename G::node_type*>& node_map) {
+        using node = typename G::node_type;
+        using T = typename G::value_type;
+        G g = G();
         string line;
         std::ifstream file;
         file.open(file_name);
         if (file.is_open()) {
             while (getline(file, line)) {
                 std::stringstream s(line);
-                string s_u_id, s_v_id, s_capacity;
+                string s_u_id, s_v_id;
+                T capacity;
 
-                s >> s_u_id >> s_v_id >> s_capacity;
+                s >> s_u_id >> s_v_id >> capacity;
                 int u_id = stoi(s_u_id), v_id = stoi(s_v_id);
 
                 if (node_map.find(u_id) == node_map.end()) {
@@ -248,7 +715,7 @@ namespace tests {
                     node_map.insert({ v_id, v });
                 }
 
-                g.add_edge(*node_map[u_id], *node_map[v_id], stoll(s_capacity));
+                g.add_edge(*node_map[u_id], *node_map[v_id], capacity);
 
             }
         }
@@ -256,41 +723,73 @@ namespace tests {
         return g;
     }
 
-	inline vector<long long> get_flows(string file_name, int n_nodes){
-		vector<long long> results;
+	// builds the graph of devices 1 to n_nodes with the given arcs
+	template <typename G = graph>
+	G get_graph_from_arcs(vector<tuple<int, int, typename G::value_type>> const& arcs, int n_nodes, unordered_map<int, typename G::node_type*>& node_map) {
+		using node = typename G::node_type;
+		G g = G();
+		for (int id = 1; id <= n_nodes; id++) {
+			node* u = new node(id);
+			g.add_node(u);
+			node_map.insert({ id, u });
+		}
+		for (auto const& a : arcs) {
+			for (int id : {get<0>(a), get<1>(a)}) {
+				if (node_map.find(id) == node_map.end()) {
+					node* u = new node(id);
+					g.add_node(u);
+					node_map.insert({ id, u });
+				}
+			}
+			g.add_edge(*node_map[get<0>(a)], *node_map[get<1>(a)], get<2>(a));
+		}
+		return g;
+	}
 
-		std::unordered_map<int, node*> node_map;
-		graph g = get_graph_from_file(file_name, node_map);
-		results.push_back(get_flow_multiple(g, vector<int>{1}, vector<int>{n_nodes}, node_map));
-		
-		node_map.clear();
-		g = get_graph_from_file(file_name, node_map);
-		results.push_back(get_flow_multiple(g, vector<int>{1, 2}, vector<int>{n_nodes}, node_map));
-
-		node_map.clear();
-		g = get_graph_from_file(file_name, node_map);
-		results.push_back(get_flow_multiple(g, vector<int>{1, 2}, vector<int>{n_nodes, n_nodes - 1}, node_map));
-
-		node_map.clear();
-		g = get_graph_from_file(file_name, node_map);
-		results.push_back(get_flow_multiple(g, vector<int>{2}, vector<int>{n_nodes, n_nodes - 1}, node_map));
-
-		node_map.clear();
-		g = get_graph_from_file(file_name, node_map);
-		long long last_test = get_flow_multiple(g, vector<int>{2}, vector<int>{n_nodes - 1}, node_map);
-		results.push_back(last_test);
-		results.push_back(last_test);
+	// sources and sinks of the successive phases of a simulation (one per time_step)
+	inline vector<pair<vector<int>, vector<int>>> get_phases(int n_nodes){
+		return {
+			{{1}, {n_nodes}},
+			{{1, 2}, {n_nodes}},
+			{{1, 2}, {n_nodes, n_nodes - 1}},
+			{{2}, {n_nodes, n_nodes - 1}},
+			{{2}, {n_nodes - 1}}
+		};
+	}
+
+	template <typename G = graph>
+	inline vector<typename G::value_type> get_flows(string file_name, int n_nodes, bool certify = false){
+		vector<typename G::value_type> results;
+
+		for (auto const& phase : get_phases(n_nodes)) {
+			std::unordered_map<int, typename G::node_type*> node_map;
+			G g = get_graph_from_file<G>(file_name, node_map);
+			results.push_back(get_flow_multiple(g, phase.first, phase.second, node_map, certify));
+		}
+		// the last phase lasts until the end of the simulation
+		results.push_back(results.back());
 
 		return results;
 	}
 
-	long long get_flow_multiple(graph g, vector<int> sources, vector<int> sinks, unordered_map<int, node*>& node_map){
+	// adds a virtual source feeding the sources and a virtual sink fed by the sinks, returning them
+	template <typename G>
+	pair<typename G::node_type*, typename G::node_type*> add_terminals(G& g, vector<int> const& sources, vector<int> const& sinks, unordered_map<int, typename G::node_type*>& node_map){
+		using node = typename G::node_type;
+		using T = typename G::value_type;
+		constexpr T inf = numeric_limits<T>::max();
+
 		// Add virtual source
 		node* v_source = new node(0);
 		g.add_node(v_source);
 
 		for(int s : sources){
-			g.add_edge(*v_source, *node_map[s], LLONG_MAX);
+			// no more than the outgoing capacity can leave a source: bounding the virtual arc keeps excesses from overflowing
+			T out_capacity = 0;
+			for (auto* e : node_map[s]->neighbors) {
+				out_capacity = e->capacity < inf - out_capacity ? out_capacity + e->capacity : inf;
+			}
+			g.add_edge(*v_source, *node_map[s], out_capacity);
 		}
 
 		// Add virtual sink
@@ -298,10 +797,102 @@ namespace tests {
 		g.add_node(v_sink);
 
 		for(int s : sinks){
-			g.add_edge(*node_map[s], *v_sink, LLONG_MAX);
+			g.add_edge(*node_map[s], *v_sink, inf);
 		}
+		return {v_source, v_sink};
+	}
 
-		return g.get_max_flow(*v_source, *v_sink);
+	template <typename G>
+	typename G::value_type get_flow_multiple(G g, vector<int> sources, vector<int> sinks, unordered_map<int, typename G::node_type*>& node_map, bool certify){
+		using T = typename G::value_type;
+
+		auto [v_source, v_sink] = add_terminals(g, sources, sinks, node_map);
+		T flow = g.get_max_flow(*v_source, *v_sink);
+
+		// linear-time proof of optimality
+		if (certify) {
+			flow_certificate<T> cert = g.certify();
+			if (!cert) {
+				std::cerr << "flow certificate failed (flow " << cert.flow << ", cut " << cert.cut
+				          << ", capacity " << cert.capacity << ", skew " << cert.skew
+				          << ", conservation " << cert.conservation << ", separated " << cert.separated << ")\n";
+			}
+		}
+		return flow;
+	}
+
+	// state of the aggregate algorithm at the end of the first phase, from the solution of the reference solver
+	template <typename T>
+	struct warm_start {
+		device_capacities<T> flows; // net flow from each device towards its neighbours
+		vector<int> heights;        // exact distance labels of devices
+	};
+
+	template <typename G = graph>
+	warm_start<typename G::value_type> get_warm_start(string file_name, int n_nodes){
+		using node = typename G::node_type;
+		using T = typename G::value_type;
+		std::unordered_map<int, node*> node_map;
+		G g = get_graph_from_file<G>(file_name, node_map);
+		pair<vector<int>, vector<int>> phase = get_phases(n_nodes)[0];
+		auto [v_source, v_sink] = add_terminals(g, phase.first, phase.second, node_map);
+		g.get_max_flow(*v_source, *v_sink);
+
+		// net flows and residual arcs between devices (virtual terminals excluded)
+		warm_start<T> w;
+		vector<tuple<int, int, T>> flows;
+		vector<vector<int>> residual_in(n_nodes + 1);
+		for (auto const& x : node_map) {
+			for (auto* e : x.second->neighbors) {
+				int u = e->u->id, v = e->v->id;
+				if (e->v == v_source || e->v == v_sink || u < 1 || u > n_nodes || v < 1 || v > n_nodes) {
+					continue;
+				}
+				flows.emplace_back(u, v, e->flow);
+				if (e->capacity - e->flow > 0) {
+					residual_in[v].push_back(u);
+				}
+			}
+		}
+		w.flows = make_device_capacities(flows, n_nodes);
+
+		// distances to sinks (or to sources, above n_nodes) in the residual graph, not crossing sources
+		auto distances = [&](vector<int> const& from) {
+			vector<int> d(n_nodes + 1, -1);
+			deque<int> queue;
+			for (int s : phase.first) {
+				d[s] = INT_MAX;
+			}
+			for (int s : from) {
+				d[s] = 0;
+				queue.push_back(s);
+			}
+			while (!queue.empty()) {
+				int v = queue.front();
+				queue.pop_front();
+				for (int u : residual_in[v]) {
+					if (d[u] < 0) {
+						d[u] = d[v] + 1;
+						queue.push_back(u);
+					}
+				}
+			}
+			return d;
+		};
+		vector<int> to_sink = distances(phase.second), to_source = distances(phase.first);
+		w.heights.resize(n_nodes);
+		for (int u = 1; u <= n_nodes; u++) {
+			if (to_sink[u] == INT_MAX) {
+				w.heights[u - 1] = n_nodes;
+			}
+			else if (to_sink[u] >= 0) {
+				w.heights[u - 1] = to_sink[u];
+			}
+			else {
+				w.heights[u - 1] = to_source[u] >= 0 ? n_nodes + to_source[u] : 2 * n_nodes;
+			}
+		}
+		return w;
 	}
 }
 
@@ -0,0 +1,181 @@
+#ifndef PUSH_RELABEL_ORACLE_H
+#define PUSH_RELABEL_ORACLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "openmp.hpp"
+
+using namespace std;
+
+// Reference solver on real-valued capacities: each snapshot is solved sequentially (with global and
+// gap relabelling), as snapshots are already solved in parallel.
+using real_graph = basic_graph<policy::highest_label, policy::single_push, policy::heuristics<true, true>, double>;
+
+// Maximum flow from a source to a sink device in the unit-disk graph of devices at given positions,
+// with links up to range in both directions and capacities from their length. Pairs of devices
+// within range are found by bucketing positions in a grid of cells as large as the range.
+inline double unit_disk_flow(vector<double> const& x, vector<double> const& y, double range, function<double(double)> const& capacity, int source, int sink) {
+	int n = x.size();
+	auto cell = [&](int i) {
+		return make_pair(static_cast<int64_t>(floor(x[i] / range)), static_cast<int64_t>(floor(y[i] / range)));
+	};
+	auto key = [](int64_t cx, int64_t cy) {
+		return static_cast<uint64_t>(cx) * 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(cy);
+	};
+	unordered_map<uint64_t, vector<int>> grid;
+	for (int i = 0; i < n; i++) {
+		auto c = cell(i);
+		grid[key(c.first, c.second)].push_back(i);
+	}
+	vector<tuple<int, int, double>> arcs;
+	for (int i = 0; i < n; i++) {
+		auto c = cell(i);
+		for (int64_t dx = -1; dx <= 1; dx++) {
+			for (int64_t dy = -1; dy <= 1; dy++) {
+				auto it = grid.find(key(c.first + dx, c.second + dy));
+				if (it == grid.end()) {
+					continue;
+				}
+				for (int j : it->second) {
+					double d = hypot(x[i] - x[j], y[i] - y[j]);
+					if (j > i && d <= range) {
+						double k = capacity(d);
+						arcs.emplace_back(i + 1, j + 1, k);
+						arcs.emplace_back(j + 1, i + 1, k);
+					}
+				}
+			}
+		}
+	}
+	unordered_map<int, real_graph::node_type*> node_map;
+	real_graph g = tests::get_graph_from_arcs<real_graph>(arcs, n, node_map);
+	return tests::get_flow_multiple(g, {source + 1}, {sink + 1}, node_map);
+}
+
+// Collects the positions of devices at every step (and the flow reaching the sink), and computes the
+// maximum flow of every complete snapshot on a background pool of threads, off the simulation.
+class snapshot_oracle {
+public:
+	snapshot_oracle(int devices, double range, function<double(double)> capacity, int source, int sink, size_t threads = max(1u, thread::hardware_concurrency() / 2))
+	: devices(devices), range(range), capacity(move(capacity)), source(source), sink(sink) {
+		for (size_t i = 0; i < threads; i++) {
+			pool.emplace_back([this]() {
+				work();
+			});
+		}
+	}
+
+	~snapshot_oracle() {
+		{
+			lock_guard<mutex> lock(m);
+			stopping = true;
+		}
+		ready.notify_all();
+		for (auto& t : pool) {
+			t.join();
+		}
+	}
+
+	// Reports the position of a device at a step (once per step, from concurrent rounds).
+	void report(int step, int device, double x, double y, double sink_flow) {
+		lock_guard<mutex> lock(m);
+		snapshot& s = partial[step];
+		if (s.reported.empty()) {
+			s.step = step;
+			s.x.resize(devices);
+			s.y.resize(devices);
+			s.reported.resize(devices);
+		}
+		if (device < 0 || device >= devices || s.reported[device]) {
+			return;
+		}
+		s.reported[device] = true;
+		s.x[device] = x;
+		s.y[device] = y;
+		s.sink_flow += sink_flow;
+		if (++s.count == devices) {
+			queue.push_back(move(s));
+			partial.erase(step);
+			ready.notify_one();
+		}
+	}
+
+	// Waits for the snapshots queued, returning the step, sink flow and maximum flow of each in order.
+	vector<tuple<int, double, double>> results() {
+		unique_lock<mutex> lock(m);
+		done.wait(lock, [this]() {
+			return queue.empty() && busy == 0;
+		});
+		vector<tuple<int, double, double>> r;
+		for (auto const& x : solved) {
+			r.emplace_back(x.first, x.second.first, x.second.second);
+		}
+		return r;
+	}
+
+	// The steps not solved as some device did not report, with the number of devices that did.
+	vector<pair<int, int>> dropped() {
+		lock_guard<mutex> lock(m);
+		vector<pair<int, int>> r;
+		for (auto const& x : partial) {
+			r.emplace_back(x.first, x.second.count);
+		}
+		return r;
+	}
+
+private:
+	struct snapshot {
+		int step = 0, count = 0;
+		vector<double> x, y;
+		vector<bool> reported;
+		double sink_flow = 0;
+	};
+
+	void work() {
+		unique_lock<mutex> lock(m);
+		while (true) {
+			ready.wait(lock, [this]() {
+				return stopping || !queue.empty();
+			});
+			if (queue.empty()) {
+				return;
+			}
+			snapshot s = move(queue.front());
+			queue.pop_front();
+			busy++;
+			lock.unlock();
+			double flow = unit_disk_flow(s.x, s.y, range, capacity, source, sink);
+			lock.lock();
+			solved[s.step] = {s.sink_flow, flow};
+			busy--;
+			done.notify_all();
+		}
+	}
+
+	int const devices;
+	double const range;
+	function<double(double)> const capacity;
+	int const source, sink;
+
+	mutex m;
+	condition_variable ready, done;
+	map<int, snapshot> partial;
+	deque<snapshot> queue;
+	map<int, pair<double, double>> solved;
+	int busy = 0;
+	bool stopping = false;
+	vector<thread> pool;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef PUSH_RELABEL_PARAMETERS_H
+#define PUSH_RELABEL_PARAMETERS_H
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// Length of the phases of sources and sinks by default (also the longest skip of rounds), and their number.
+constexpr int default_phase_time = 200;
+constexpr int default_phase_number = 5;
+// Side of the simulation area by default.
+constexpr int default_area_side = 500;
+
+// Parameters set at runtime, shared by simulations (passed to the network through its initialisation
+// values) and emulations of the algorithm. Whether rounds are synchronous is chosen at
+// build time instead (see option::sync_rounds), as it selects the round schedule type.
+struct parameters {
+	double phase_time = default_phase_time; // length of the phases of sources and sinks (unless given by a scenario)
+	double end_time = 0;                    // when rounds and logs end (if positive, otherwise at the end of the phases)
+	double round_period = 1;                // mean time between rounds (at most 1, as messages are retained for 2 seconds)
+	double round_deviation = 0.1;           // deviation of the time between rounds (asynchronous rounds only)
+	double area_side = default_area_side;   // side of the square area where devices are dispersed (graphical simulations only)
+	double error_threshold = 0.01;          // relative error of the sink flow within which it is timed to get after every change (batch simulations only)
+
+	// When rounds and logs end.
+	double last() const {
+		return end_time > 0 ? end_time : default_phase_number * phase_time;
+	}
+
+	// Sets a parameter from an assignment "<name>=<value>", returning whether it is a valid one (leaving
+	// the parameters unchanged otherwise).
+	bool set(string const& assignment) {
+		size_t eq = assignment.find('=');
+		if (eq == string::npos) {
+			return false;
+		}
+		string name = assignment.substr(0, eq);
+		istringstream value(assignment.substr(eq + 1));
+		map<string, double*> const values = {
+			{"phase_time", &phase_time}, {"end_time", &end_time}, {"round_period", &round_period},
+			{"round_deviation", &round_deviation}, {"area_side", &area_side}, {"error_threshold", &error_threshold}
+		};
+		auto it = values.find(name);
+		double x;
+		if (it == values.end() || !(value >> x)) {
+			return false;
+		}
+		// messages are retained for 2 seconds (as set at compile time), which longer periods would outlast
+		if (it->second == &round_period && !(x > 0 && x <= 1)) {
+			return false;
+		}
+		*it->second = x;
+		return true;
+	}
+
+	// Sets parameters from a file of assignments (one per line, with # comments), returning whether it was
+	// read with no invalid ones (which are reported).
+	bool read(string const& file) {
+		ifstream in(file);
+		string line;
+		bool valid = true;
+		while (getline(in, line)) {
+			line = line.substr(0, line.find('#'));
+			line.erase(remove_if(line.begin(), line.end(), [](char c){ return isspace(c); }), line.end());
+			if (!line.empty() && !set(line)) {
+				cerr << file << ": invalid parameter " << line << endl;
+				valid = false;
+			}
+		}
+		return valid && !in.bad() && in.eof();
+	}
+
+	// Suffix of plot names, listing the parameters differing from their defaults.
+	string suffix() const {
+		parameters d;
+		ostringstream s;
+		if (phase_time != d.phase_time) s << "_phase" << phase_time;
+		if (end_time != d.end_time) s << "_end" << end_time;
+		if (round_period != d.round_period) s << "_period" << round_period;
+		if (round_deviation != d.round_deviation) s << "_deviation" << round_deviation;
+		return s.str();
+	}
+};
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef PUSH_RELABEL_SCENARIO_H
+#define PUSH_RELABEL_SCENARIO_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "openmp.hpp"
+
+using namespace std;
+
+// A timed change of the network: new sources or sinks, the capacity of an arc, or the failure or
+// recovery of a device (setting the capacities of all its arcs to zero, and restoring them).
+struct scenario_event {
+	enum kind_t { sources, sinks, capacity, fail, recover };
+
+	double time;
+	kind_t kind;
+	vector<int> devices; // the new terminals, the endpoints of the arc, or the device
+	long long value = 0; // the new capacity
+};
+
+// Reads timed events from a text file, one per line:
+//   <time> sources <device>...
+//   <time> sinks <device>...
+//   <time> capacity <u> <v> <capacity>
+//   <time> fail <device>
+//   <time> recover <device>
+// Negative devices count from the last one (-1 is n_nodes), empty lines and # comments are skipped,
+// invalid lines are reported and skipped, and a file that cannot be read aborts.
+inline vector<scenario_event> read_events(string file_name, int n_nodes) {
+	static map<string, scenario_event::kind_t> const kinds = {
+		{"sources", scenario_event::sources}, {"sinks", scenario_event::sinks}, {"capacity", scenario_event::capacity},
+		{"fail", scenario_event::fail}, {"recover", scenario_event::recover}
+	};
+	vector<scenario_event> events;
+	string line;
+	std::ifstream file(file_name);
+	if (!file) {
+		std::cerr << file_name << ": cannot read events" << std::endl;
+		std::abort();
+	}
+	for (int number = 1; getline(file, line); number++) {
+		line = line.substr(0, line.find('#'));
+		std::stringstream s(line);
+		scenario_event e;
+		string kind;
+		if (!(s >> e.time)) {
+			if (line.find_first_not_of(" \t\r") != string::npos) {
+				std::cerr << file_name << ":" << number << ": invalid event " << line << std::endl;
+			}
+			continue;
+		}
+		if (!(s >> kind) || kinds.count(kind) == 0) {
+			std::cerr << file_name << ":" << number << ": invalid event " << line << std::endl;
+			continue;
+		}
+		e.kind = kinds.at(kind);
+		if (e.kind == scenario_event::capacity) {
+			int u, v;
+			if (!(s >> u >> v >> e.value)) {
+				std::cerr << file_name << ":" << number << ": invalid event " << line << std::endl;
+				continue;
+			}
+			e.devices = {u, v};
+		}
+		else {
+			for (int d; s >> d;) {
+				e.devices.push_back(d);
+			}
+		}
+		for (int& d : e.devices) {
+			d = d < 0 ? n_nodes + 1 + d : d;
+		}
+		events.push_back(e);
+	}
+	return events;
+}
+
+// Events changing sources and sinks as the phases of tests::get_phases, each lasting step.
+inline vector<scenario_event> phase_events(int n_nodes, double step) {
+	vector<scenario_event> events;
+	auto phases = tests::get_phases(n_nodes);
+	for (size_t i = 0; i < phases.size(); i++) {
+		events.push_back({i * step, scenario_event::sources, phases[i].first});
+		events.push_back({i * step, scenario_event::sinks, phases[i].second});
+	}
+	return events;
+}
+
+// The successive states of the network in a simulation, the i-th from start[i] to start[i+1].
+struct scenario {
+	vector<double> start;
+	vector<vector<int>> sources, sinks;               // sorted terminals of each state
+	vector<vector<tuple<int, int, long long>>> changes; // arcs (sorted) whose capacity is set at the start of each state
+	vector<uint64_t> hash;                            // content hash of each state
+
+	int size() const {
+		return static_cast<int>(start.size());
+	}
+
+	// the state at time t
+	int at(double t) const {
+		return max(0, static_cast<int>(upper_bound(start.begin(), start.end(), t) - start.begin()) - 1);
+	}
+
+	// the start of the state following the one at time t (infinity if none)
+	double next_change(double t) const {
+		int i = at(t) + 1;
+		return i < size() ? start[i] : numeric_limits<double>::infinity();
+	}
+
+	bool is_source(int i, int device) const {
+		return binary_search(sources[i].begin(), sources[i].end(), device);
+	}
+
+	bool is_sink(int i, int device) const {
+		return binary_search(sinks[i].begin(), sinks[i].end(), device);
+	}
+
+	// the arcs from a device whose capacity is set at the start of the i-th state
+	pair<tuple<int, int, long long> const*, tuple<int, int, long long> const*> changed(int i, int device) const {
+		auto const& c = changes[i];
+		auto first = lower_bound(c.begin(), c.end(), make_tuple(device, numeric_limits<int>::min(), numeric_limits<long long>::min()));
+		auto last = lower_bound(first, c.end(), make_tuple(device + 1, numeric_limits<int>::min(), numeric_limits<long long>::min()));
+		return {c.data() + (first - c.begin()), c.data() + (last - c.begin())};
+	}
+};
+
+namespace scenario_hash {
+	inline uint64_t mix(uint64_t x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	// arcs with no capacity do not contribute, as if missing
+	inline uint64_t arc(int u, int v, long long c) {
+		if (c == 0) {
+			return 0;
+		}
+		return mix(mix((static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v)) ^ static_cast<uint64_t>(c));
+	}
+
+	inline uint64_t devices(vector<int> const& d, uint64_t seed) {
+		uint64_t h = mix(seed);
+		for (int x : d) {
+			h = mix(h ^ static_cast<uint32_t>(x));
+		}
+		return h;
+	}
+}
+
+// Builds the states of a network with the given arcs under timed events (all devices starting
+// up, with no terminals unless set at time 0, and events before time 0 happening at it). The hash
+// of a state depends only on its terminals and capacities, and is updated from the arcs changed.
+// Capacity events between devices that are not adjacent are reported and skipped, as devices only
+// exchange flow with their neighbours.
+inline scenario make_scenario(vector<scenario_event> events, vector<tuple<int, int, long long>> const& arcs) {
+	for (auto& e : events) {
+		e.time = max(e.time, 0.0);
+	}
+	stable_sort(events.begin(), events.end(), [](auto const& x, auto const& y) {
+		return x.time < y.time;
+	});
+
+	// capacities set by arcs and events, and the arcs of every device (in both directions)
+	map<pair<int, int>, long long> capacity;
+	map<int, set<pair<int, int>>> incident;
+	auto add_arc = [&](int u, int v, long long c) {
+		capacity[{u, v}] += c;
+		incident[u].insert({u, v});
+		incident[v].insert({u, v});
+	};
+	for (auto const& a : arcs) {
+		add_arc(get<0>(a), get<1>(a), get<2>(a));
+	}
+	set<pair<int, int>> adjacent;
+	for (auto const& x : capacity) {
+		adjacent.insert(x.first);
+		adjacent.insert({x.first.second, x.first.first});
+	}
+	set<int> failed;
+	auto effective = [&](pair<int, int> const& a) {
+		return failed.count(a.first) || failed.count(a.second) ? 0 : capacity[a];
+	};
+	uint64_t arc_hash = 0;
+	for (auto const& x : capacity) {
+		arc_hash += scenario_hash::arc(x.first.first, x.first.second, x.second);
+	}
+
+	scenario s;
+	vector<int> sources, sinks;
+	auto state_hash = [&]() {
+		return arc_hash ^ scenario_hash::devices(sources, 1) ^ scenario_hash::devices(sinks, 2);
+	};
+	s.start.push_back(0);
+	s.changes.emplace_back();
+	s.sources.emplace_back();
+	s.sinks.emplace_back();
+	s.hash.push_back(state_hash());
+	for (size_t i = 0; i < events.size();) {
+		double t = events[i].time;
+		map<pair<int, int>, long long> before; // effective capacity of the arcs touched, before the events
+		auto touch = [&](pair<int, int> const& a) {
+			before.emplace(a, effective(a));
+		};
+		for (; i < events.size() && events[i].time == t; i++) {
+			scenario_event const& e = events[i];
+			switch (e.kind) {
+			case scenario_event::sources:
+				sources = e.devices;
+				break;
+			case scenario_event::sinks:
+				sinks = e.devices;
+				break;
+			case scenario_event::capacity:
+				if (!adjacent.count({e.devices[0], e.devices[1]})) {
+					std::cerr << "capacity event at time " << e.time << " skipped: devices " << e.devices[0] << " and " << e.devices[1] << " are not adjacent" << std::endl;
+					break;
+				}
+				if (!capacity.count({e.devices[0], e.devices[1]})) {
+					add_arc(e.devices[0], e.devices[1], 0);
+				}
+				touch({e.devices[0], e.devices[1]});
+				capacity[{e.devices[0], e.devices[1]}] = e.value;
+				break;
+			case scenario_event::fail:
+			case scenario_event::recover:
+				for (int d : e.devices) {
+					for (auto const& a : incident[d]) {
+						touch(a);
+					}
+					if (e.kind == scenario_event::fail) {
+						failed.insert(d);
+					}
+					else {
+						failed.erase(d);
+					}
+				}
+				break;
+			}
+		}
+		vector<tuple<int, int, long long>> changes;
+		for (auto const& x : before) {
+			long long c = effective(x.first);
+			if (c != x.second) {
+				changes.emplace_back(x.first.first, x.first.second, c);
+				arc_hash += scenario_hash::arc(x.first.first, x.first.second, c) - scenario_hash::arc(x.first.first, x.first.second, x.second);
+			}
+		}
+		sort(sources.begin(), sources.end());
+		sort(sinks.begin(), sinks.end());
+		// events at time 0 set up the first state
+		if (t > 0) {
+			s.start.push_back(t);
+			s.changes.emplace_back();
+			s.sources.emplace_back();
+			s.sinks.emplace_back();
+			s.hash.emplace_back();
+		}
+		s.changes.back() = move(changes);
+		s.sources.back() = sources;
+		s.sinks.back() = sinks;
+		s.hash.back() = state_hash();
+	}
+	return s;
+}
+
+namespace tests {
+	// Reference solver of the states of a scenario: sequential (with global and gap relabelling), as
+	// distinct states are solved in parallel instead.
+	using scenario_graph = basic_graph<policy::highest_label, policy::single_push, policy::heuristics<true, true>, long long>;
+
+	// Maximum flow of every state of a scenario. Flows of distinct states are computed in parallel (by the
+	// given number of threads, one state each), and cached by content hash in a file (if given), so that
+	// equal states are only solved once across runs.
+	template <typename G = scenario_graph>
+	vector<typename G::value_type> get_scenario_flows(scenario const& s, vector<tuple<int, int, long long>> const& arcs, int n_nodes, string cache_file = "", size_t threads = max(1u, thread::hardware_concurrency())) {
+		using T = typename G::value_type;
+		unordered_map<uint64_t, T> cache;
+		{
+			std::ifstream in(cache_file);
+			uint64_t h;
+			T flow;
+			while (in >> std::hex >> h >> std::dec >> flow) {
+				cache.emplace(h, flow);
+			}
+		}
+		size_t cached = cache.size();
+
+		// replays the changes of capacities, collecting every new state not yet cached
+		struct job {
+			uint64_t hash;
+			int state;
+			vector<tuple<int, int, T>> arcs;
+			T flow = 0;
+		};
+		vector<job> jobs;
+		set<uint64_t> queued;
+		map<pair<int, int>, T> capacity;
+		for (auto const& a : arcs) {
+			capacity[{get<0>(a), get<1>(a)}] += get<2>(a);
+		}
+		for (int i = 0; i < s.size(); i++) {
+			for (auto const& c : s.changes[i]) {
+				capacity[{get<0>(c), get<1>(c)}] = get<2>(c);
+			}
+			if (cache.count(s.hash[i]) || !queued.insert(s.hash[i]).second) {
+				continue;
+			}
+			jobs.push_back({s.hash[i], i, {}});
+			if (!s.sources[i].empty() && !s.sinks[i].empty()) {
+				for (auto const& x : capacity) {
+					if (x.second > 0) {
+						jobs.back().arcs.emplace_back(x.first.first, x.first.second, x.second);
+					}
+				}
+			}
+		}
+
+		// every thread takes the next state to solve, releasing its arcs once solved
+		atomic<size_t> next{0};
+		auto solve = [&]() {
+			for (size_t j; (j = next++) < jobs.size(); ) {
+				job& x = jobs[j];
+				if (!s.sources[x.state].empty() && !s.sinks[x.state].empty()) {
+					std::unordered_map<int, typename G::node_type*> node_map;
+					G g = get_graph_from_arcs<G>(x.arcs, n_nodes, node_map);
+					x.flow = get_flow_multiple(g, s.sources[x.state], s.sinks[x.state], node_map);
+				}
+				vector<tuple<int, int, T>>().swap(x.arcs);
+			}
+		};
+		vector<thread> pool;
+		for (size_t w = 1; w < min(threads, jobs.size()); w++) {
+			pool.emplace_back(solve);
+		}
+		solve();
+		for (auto& t : pool) {
+			t.join();
+		}
+		for (auto const& x : jobs) {
+			cache.emplace(x.hash, x.flow);
+		}
+
+		if (!cache_file.empty() && cache.size() > cached) {
+			std::ofstream out(cache_file);
+			for (auto const& x : cache) {
+				out << std::hex << x.first << std::dec << " " << x.second << "\n";
+			}
+		}
+		vector<T> flows;
+		for (int i = 0; i < s.size(); i++) {
+			flows.push_back(cache.at(s.hash[i]));
+		}
+		return flows;
+	}
+}
+
+#endif
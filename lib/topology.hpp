@@ -0,0 +1,202 @@
+#ifndef PUSH_RELABEL_TOPOLOGY_H
+#define PUSH_RELABEL_TOPOLOGY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Flow network in CSR form, with every arc paired to its reverse.
+template <typename T>
+struct topology {
+	vector<int> ids;     // input id of each vertex
+	vector<int> start;   // the arcs leaving u are [start[u], start[u+1])
+	vector<int> head;    // target vertex of each arc
+	vector<int> reverse; // reverse of each arc
+	vector<T> capacity;
+	int source = -1, sink = -1;
+
+	int size() const {
+		return static_cast<int>(ids.size());
+	}
+};
+
+// Reads the arcs of an input .txt file as (u, v, capacity) triples.
+template <typename T>
+vector<tuple<int, int, T>> read_arcs(string file_name) {
+	vector<tuple<int, int, T>> arcs;
+	string line;
+	std::ifstream file(file_name);
+	while (getline(file, line)) {
+		std::stringstream s(line);
+		int u, v;
+		T capacity;
+		if (s >> u >> v >> capacity) {
+			arcs.emplace_back(u, v, capacity);
+		}
+	}
+	return arcs;
+}
+
+// Builds the network with a virtual source feeding the sources and a virtual sink fed by the sinks.
+template <typename T>
+topology<T> make_topology(vector<tuple<int, int, T>> const& arcs, vector<int> const& sources, vector<int> const& sinks) {
+	constexpr T inf = numeric_limits<T>::max();
+	topology<T> t;
+	unordered_map<int, int> index;
+	auto vertex = [&](int id) {
+		auto it = index.find(id);
+		if (it != index.end()) {
+			return it->second;
+		}
+		index.emplace(id, t.size());
+		t.ids.push_back(id);
+		return t.size() - 1;
+	};
+
+	vector<tuple<int, int, T>> all;
+	for (auto const& a : arcs) {
+		all.emplace_back(vertex(get<0>(a)), vertex(get<1>(a)), get<2>(a));
+	}
+	for (int s : sources) {
+		vertex(s);
+	}
+	for (int s : sinks) {
+		vertex(s);
+	}
+	vector<T> out_capacity(t.size(), 0);
+	for (auto const& a : all) {
+		T& c = out_capacity[get<0>(a)];
+		c = get<2>(a) < inf - c ? c + get<2>(a) : inf;
+	}
+
+	// virtual terminals, outside of the input ids
+	t.source = t.size();
+	t.ids.push_back(0);
+	t.sink = t.size();
+	t.ids.push_back(999);
+	for (int s : sources) {
+		// no more than the outgoing capacity can leave a source
+		all.emplace_back(t.source, index[s], out_capacity[index[s]]);
+	}
+	for (int s : sinks) {
+		all.emplace_back(index[s], t.sink, inf);
+	}
+
+	int n = t.size();
+	t.start.assign(n + 1, 0);
+	for (auto const& a : all) {
+		t.start[get<0>(a) + 1]++;
+		t.start[get<1>(a) + 1]++;
+	}
+	for (int i = 0; i < n; i++) {
+		t.start[i + 1] += t.start[i];
+	}
+	vector<int> fill(t.start.begin(), t.start.end() - 1);
+	t.head.resize(t.start[n]);
+	t.reverse.resize(t.start[n]);
+	t.capacity.resize(t.start[n]);
+	for (auto const& a : all) {
+		int u = get<0>(a), v = get<1>(a);
+		int forward = fill[u]++, backward = fill[v]++;
+		t.head[forward] = v;
+		t.head[backward] = u;
+		t.reverse[forward] = backward;
+		t.reverse[backward] = forward;
+		t.capacity[forward] = get<2>(a);
+		t.capacity[backward] = 0;
+	}
+	return t;
+}
+
+// Outgoing capacities of devices 1..n in CSR form (sorted by target), as stored in binary .csr files.
+template <typename T>
+struct device_capacities {
+	vector<int> start; // the arcs leaving device u are [start[u-1], start[u])
+	vector<int> head;  // target device of each arc
+	vector<T> capacity;
+
+	int size() const {
+		return static_cast<int>(start.size()) - 1;
+	}
+};
+
+// Groups the arcs by device, merging parallel arcs.
+template <typename T>
+device_capacities<T> make_device_capacities(vector<tuple<int, int, T>> arcs, int n) {
+	sort(arcs.begin(), arcs.end());
+	device_capacities<T> d;
+	d.start.assign(n + 1, 0);
+	int last_u = 0, last_v = 0;
+	for (auto const& a : arcs) {
+		int u = get<0>(a), v = get<1>(a);
+		if (u == last_u && v == last_v) {
+			d.capacity.back() += get<2>(a);
+			continue;
+		}
+		d.head.push_back(v);
+		d.capacity.push_back(get<2>(a));
+		d.start[u]++;
+		last_u = u;
+		last_v = v;
+	}
+	for (int u = 1; u <= n; u++) {
+		d.start[u] += d.start[u - 1];
+	}
+	return d;
+}
+
+namespace csr_format {
+	constexpr char magic[8] = {'P', 'R', 'C', 'S', 'R', 0, 0, 1};
+
+	// header following the magic
+	struct header {
+		int64_t devices, arcs, value_size;
+	};
+}
+
+// Writes capacities to a binary .csr file, returning whether it succeeded.
+template <typename T>
+bool write_csr(string file_name, device_capacities<T> const& d) {
+	std::ofstream file(file_name, std::ios::binary);
+	csr_format::header h{d.size(), static_cast<int64_t>(d.head.size()), sizeof(T)};
+	file.write(csr_format::magic, sizeof(csr_format::magic));
+	file.write(reinterpret_cast<char const*>(&h), sizeof(h));
+	file.write(reinterpret_cast<char const*>(d.start.data()), d.start.size() * sizeof(int));
+	file.write(reinterpret_cast<char const*>(d.head.data()), d.head.size() * sizeof(int));
+	file.write(reinterpret_cast<char const*>(d.capacity.data()), d.capacity.size() * sizeof(T));
+	return static_cast<bool>(file);
+}
+
+// Reads capacities from a binary .csr file in bulk (with no devices if missing or invalid).
+template <typename T>
+device_capacities<T> read_csr(string file_name) {
+	device_capacities<T> d;
+	std::ifstream file(file_name, std::ios::binary);
+	char magic[sizeof(csr_format::magic)];
+	csr_format::header h;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, csr_format::magic, sizeof(magic)) != 0 ||
+	    !file.read(reinterpret_cast<char*>(&h), sizeof(h)) || h.value_size != sizeof(T)) {
+		return {};
+	}
+	d.start.resize(h.devices + 1);
+	d.head.resize(h.arcs);
+	d.capacity.resize(h.arcs);
+	file.read(reinterpret_cast<char*>(d.start.data()), d.start.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(d.head.data()), d.head.size() * sizeof(int));
+	file.read(reinterpret_cast<char*>(d.capacity.data()), d.capacity.size() * sizeof(T));
+	if (!file) {
+		return {};
+	}
+	return d;
+}
+
+#endif
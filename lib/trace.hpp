@@ -0,0 +1,234 @@
+#ifndef PUSH_RELABEL_TRACE_H
+#define PUSH_RELABEL_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A timed step of a thread (name must be a string literal), with the messages and bytes it moved.
+struct trace_event {
+	char const* name;
+	int64_t begin, end; // nanoseconds since tracing was enabled
+	uint32_t thread;
+	uint32_t messages;
+	uint64_t bytes;
+};
+
+// Events of a single thread, the oldest overwritten once full.
+class trace_ring {
+public:
+	trace_ring(uint32_t thread, size_t capacity) : thread(thread), events(capacity) {}
+
+	void push(trace_event const& e) {
+		events[written++ % events.size()] = e;
+	}
+
+	// events in chronological order
+	vector<trace_event> snapshot() const {
+		size_t n = min(written, events.size()), first = written - n;
+		vector<trace_event> v;
+		v.reserve(n);
+		for (size_t i = first; i < written; i++) {
+			v.push_back(events[i % events.size()]);
+		}
+		return v;
+	}
+
+	size_t dropped() const {
+		return written - min(written, events.size());
+	}
+
+	uint32_t const thread;
+
+private:
+	vector<trace_event> events;
+	size_t written = 0;
+};
+
+namespace trace_format {
+	constexpr char magic[8] = {'P', 'R', 'T', 'R', 'A', 'C', 'E', 1};
+}
+
+// Process-wide tracing of round, log and plot steps, disabled until enable() is called.
+// Recording only touches a ring of the calling thread; rings are collected when writing,
+// which must happen once the traced threads are done.
+class tracer {
+public:
+	static tracer& instance() {
+		static tracer t;
+		return t;
+	}
+
+	void enable(size_t ring_capacity = 1 << 16) {
+		capacity = max<size_t>(ring_capacity, 1);
+		origin = chrono::steady_clock::now();
+		active.store(true, memory_order_release);
+	}
+
+	bool enabled() const {
+		return active.load(memory_order_relaxed);
+	}
+
+	int64_t now() const {
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+	}
+
+	void record(char const* name, int64_t begin, int64_t end, uint32_t messages = 0, uint64_t bytes = 0) {
+		trace_ring& r = local();
+		r.push({name, begin, end, r.thread, messages, bytes});
+	}
+
+	// all events, ordered by thread and time
+	vector<trace_event> events() const {
+		lock_guard<mutex> lock(registry);
+		vector<trace_event> v;
+		for (auto const& r : rings) {
+			vector<trace_event> s = r->snapshot();
+			v.insert(v.end(), s.begin(), s.end());
+		}
+		return v;
+	}
+
+	size_t dropped() const {
+		lock_guard<mutex> lock(registry);
+		size_t d = 0;
+		for (auto const& r : rings) {
+			d += r->dropped();
+		}
+		return d;
+	}
+
+	// Writes events in the Chrome trace-event JSON format (complete events, in microseconds).
+	bool write_chrome(string file_name) const {
+		std::ofstream file(file_name);
+		file << "{\"traceEvents\":[";
+		bool first = true;
+		for (trace_event const& e : events()) {
+			file << (first ? "\n" : ",\n") << fixed << setprecision(3)
+			     << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+			     << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0
+			     << ",\"args\":{\"messages\":" << e.messages << ",\"bytes\":" << e.bytes << "}}";
+			first = false;
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return static_cast<bool>(file);
+	}
+
+	// Writes events in a compact binary form: the magic, the number of names and events, the names
+	// (each preceded by its length) and the events (name index, thread and messages as 32 bits,
+	// begin, duration and bytes as 64 bits).
+	bool write_binary(string file_name) const {
+		vector<trace_event> v = events();
+		vector<string> names;
+		map<string, uint32_t> index;
+		for (trace_event const& e : v) {
+			if (index.emplace(e.name, names.size()).second) {
+				names.push_back(e.name);
+			}
+		}
+		std::ofstream file(file_name, std::ios::binary);
+		uint64_t counts[2] = {names.size(), v.size()};
+		file.write(trace_format::magic, sizeof(trace_format::magic));
+		file.write(reinterpret_cast<char const*>(counts), sizeof(counts));
+		for (string const& s : names) {
+			uint32_t n = s.size();
+			file.write(reinterpret_cast<char const*>(&n), sizeof(n));
+			file.write(s.data(), n);
+		}
+		for (trace_event const& e : v) {
+			uint32_t small[3] = {index[e.name], e.thread, e.messages};
+			int64_t large[3] = {e.begin, e.end - e.begin, static_cast<int64_t>(e.bytes)};
+			file.write(reinterpret_cast<char const*>(small), sizeof(small));
+			file.write(reinterpret_cast<char const*>(large), sizeof(large));
+		}
+		return static_cast<bool>(file);
+	}
+
+	// Prints count, total and mean/max wall time of each step, with messages and bytes moved.
+	void summary(ostream& out) const {
+		struct total {
+			size_t count = 0;
+			int64_t time = 0, longest = 0;
+			uint64_t messages = 0, bytes = 0;
+		};
+		map<string, total> steps;
+		for (trace_event const& e : events()) {
+			total& t = steps[e.name];
+			t.count++;
+			t.time += e.end - e.begin;
+			t.longest = max(t.longest, e.end - e.begin);
+			t.messages += e.messages;
+			t.bytes += e.bytes;
+		}
+		out << "trace summary (" << dropped() << " events dropped):" << endl;
+		for (auto const& s : steps) {
+			total const& t = s.second;
+			out << "  " << s.first << ": " << t.count << " times, " << t.time / 1e9 << "s total, "
+			    << t.time / 1e3 / t.count << "us mean, " << t.longest / 1e3 << "us max";
+			if (t.messages > 0) {
+				out << ", " << t.messages << " messages, " << t.bytes << " bytes";
+			}
+			out << endl;
+		}
+	}
+
+private:
+	tracer() = default;
+
+	// ring of the calling thread, registered on first use
+	trace_ring& local() {
+		thread_local shared_ptr<trace_ring> ring;
+		if (ring == nullptr) {
+			lock_guard<mutex> lock(registry);
+			ring = make_shared<trace_ring>(rings.size(), capacity);
+			rings.push_back(ring);
+		}
+		return *ring;
+	}
+
+	atomic<bool> active{false};
+	size_t capacity = 1 << 16;
+	chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+	mutable mutex registry;
+	vector<shared_ptr<trace_ring>> rings;
+};
+
+// Records the enclosing scope as a step, if tracing is enabled.
+class trace_span {
+public:
+	explicit trace_span(char const* name) : name(name), begin(tracer::instance().enabled() ? tracer::instance().now() : -1) {}
+
+	trace_span(trace_span const&) = delete;
+	trace_span& operator=(trace_span const&) = delete;
+
+	~trace_span() {
+		if (begin >= 0) {
+			tracer::instance().record(name, begin, tracer::instance().now(), messages, bytes);
+		}
+	}
+
+	// sets the messages and bytes moved by the step
+	void moved(uint32_t m, uint64_t b) {
+		messages = m;
+		bytes = b;
+	}
+
+private:
+	char const* name;
+	int64_t begin;
+	uint32_t messages = 0;
+	uint64_t bytes = 0;
+};
+
+#endif
@@ -5,49 +5,253 @@
  * @brief Batch test of the Aggregate Push-Relabel algorithm.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "lib/fcpp.hpp"
 #include "lib/openmp.hpp"
 #include "lib/aggregate.hpp"
 
-//! @brief The main function.
-int main(int argc, char *argv[]) {
-    using namespace fcpp;
+using namespace fcpp;
 
-    // Set up the plotting object.
-    fcpp::option::plot_t p;
-    for (int test=1; test<=22; ++test) {
-        string file_number = std::to_string(test);
-        // string file_number = "14";
+//! @brief The checkpoint file of a test at a given time.
+inline std::string checkpoint_file(int test, real_t time) {
+    std::stringstream s;
+    s << "input/test" << test << ".t" << time << ".ckpt";
+    return s.str();
+}
 
-        if(test == 16){
-            continue;
+//! @brief Runs a batch network with given options and initialisation values until exit (returning its convergence times, and the rounds skipped before the start).
+template <typename O, typename I>
+std::vector<real_t> run_network(I const& init_v, long long& skipped) {
+    // Construct the network object.
+    typename component::batch_graph_simulator<O>::net network{init_v};
+    // Run the simulation until exit.
+    network.run();
+    skipped = network.storage(option::skipped_rounds{});
+    return network.storage(option::convergence_history{});
+}
+
+//! @brief Runs a test with a given variant of the algorithm and parameters, passing its rows to a plotter of type B (and returning the convergence times of every phase, and printing the wall-clock time to get within the error threshold), saving a checkpoint at a time and resuming from one at a time (if not negative), and solving the states of a scenario with a given number of threads.
+template <typename V, typename B>
+std::vector<real_t> run_test(int test, B& p, bool warm, std::string const& events, real_t save_at, real_t resume_at, option::parameters const& params, size_t oracle_threads) {
+    trace_span span("test");
+    string file_number = std::to_string(test);
+    // The name of files containing the network information.
+    const std::string file = "input/test" + file_number;
+    // The test network size
+    const int size = file_to_number(file + ".size");
+    // The states of the network over time, from the events file if given (or the default phases).
+    std::vector<tuple<int, int, long long>> arcs = read_arcs<long long>(file + ".txt");
+    auto states = std::make_shared<const scenario>(make_scenario(events.empty() ? phase_events(size, params.phase_time) : read_events(events, size), arcs));
+    // The ideal maximum flow of each state (the default ones each certified optimal by a cut of equal capacity, the others cached by content).
+    std::vector<long long> flows = events.empty() ? tests::get_flows(file + ".txt", size, true) : tests::get_scenario_flows(*states, arcs, size, file + ".flows", oracle_threads);
+    // The capacities in binary CSR form (if converted), shared by all nodes instead of parsed from the node file.
+    auto csr = std::make_shared<const device_capacities<long long>>(read_csr<long long>(file + ".csr"));
+    bool binary = csr->size() == size;
+    // The flows and heights at the end of the first phase according to the reference solver (if warm starting).
+    std::shared_ptr<const tests::warm_start<long long>> state;
+    if (warm) state = std::make_shared<const tests::warm_start<long long>>(tests::get_warm_start(file + ".txt", size));
+    // The state of all nodes to be collected, and to resume from (if of the same network, in the same state).
+    std::shared_ptr<checkpoint_recorder> recorder;
+    if (save_at >= 0) recorder = std::make_shared<checkpoint_recorder>(size, save_at, states->hash[states->at(save_at)]);
+    std::shared_ptr<const checkpoint> resumed;
+    if (resume_at >= 0) {
+        auto c = std::make_shared<const checkpoint>(read_checkpoint(checkpoint_file(test, resume_at), size));
+        if (c->size() == size and c->hash == states->hash[states->at(c->time)]) resumed = c;
+        else std::cerr << "test " << test << ": no checkpoint of this network at time " << resume_at << ", starting from scratch" << std::endl;
+    }
+    // Rounds are skipped until the checkpoint resumed from, or until the end of the first state solved by the reference solver.
+    real_t start = resumed != nullptr ? resumed->time : state != nullptr and states->size() > 1 ? states->start[1] : 0;
+    // Rows are timed on their way to the plotter.
+    option::threshold_timer<B> timer(p, params.error_threshold, *states);
+    // The initialisation values (simulation name).
+    auto init_v = common::make_tagged_tuple<option::output, option::plotter, option::nodesinput, option::arcsinput, option::node_number, option::ideal_flow_history, option::capacity_csr, option::reference_state, option::network_scenario, option::checkpoint_out, option::checkpoint_in, option::start_time, option::end_time, option::round_period, option::round_deviation, option::area_side, option::test_id>(
+        nullptr,
+        &timer,
+        file + (binary ? ".ids" : ".nodes"),
+        file + ".arcs",
+        size,
+        flows,
+        binary ? csr : nullptr,
+        state,
+        states,
+        recorder,
+        resumed,
+        times_t(start),
+        times_t(params.last()),
+        times_t(params.round_period),
+        times_t(params.round_deviation),
+        params.area_side,
+        test
+    );
+    // Run the batch simulation with the given options (sequential since tests run concurrently).
+    long long skipped = 0;
+    std::vector<real_t> convergence = run_network<option::list<false, sync_rounds, false, V, option::threshold_timer<B>>>(init_v, skipped);
+    if (skipped > 0) std::cerr << "test " << test << ": " << skipped << " rounds skipped before time " << start << " (" << (resumed != nullptr ? "resumed" : "warm start") << ")" << std::endl;
+    std::stringstream wall;
+    wall << "test " << test << " time to " << params.error_threshold * 100 << "% error (simulated/wall-clock):";
+    for (size_t i=0; i<timer.times().size(); ++i) {
+        if (timer.times()[i] < 0) wall << " none";
+        else wall << " " << timer.times()[i] << "/" << timer.wall_times()[i] << "s";
+    }
+    std::cerr << wall.str() << std::endl;
+    // Save the checkpoint, once every node got to it.
+    if (recorder != nullptr) {
+        if (not recorder->complete()) std::cerr << "test " << test << ": not every node reached time " << save_at << ", checkpoint not saved" << std::endl;
+        else if (not write_checkpoint(checkpoint_file(test, save_at), recorder->get())) std::cerr << "test " << test << ": error writing " << checkpoint_file(test, save_at) << std::endl;
+    }
+    return convergence;
+}
+
+//! @brief Runs tests concurrently with a given variant of the algorithm, passing the rows of each to its plotter (and returning their convergence times).
+template <typename V, typename B>
+std::vector<std::vector<real_t>> run_concurrently(std::vector<int> const& tests, std::vector<B*> const& plotters, bool warm, std::string const& events, real_t save_at, real_t resume_at, option::parameters const& params) {
+    // Largest tests first, so that the total time is bounded by the largest one.
+    std::vector<int> order(tests.size());
+    std::vector<int> sizes(tests.size());
+    for (size_t i=0; i<tests.size(); ++i) {
+        order[i] = i;
+        sizes[i] = file_to_number("input/test" + std::to_string(tests[i]) + ".size");
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int i, int j){
+        return sizes[i] > sizes[j];
+    });
+    // Every worker loads the input of its next test (and computes its ideal flows) while the others simulate.
+    std::vector<std::vector<real_t>> convergence(tests.size());
+    std::atomic<size_t> next{0};
+    std::mutex log_mutex;
+    size_t workers = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), tests.size()));
+    // The cores left over by the workers (if fewer than the cores) solve the states of scenarios.
+    size_t oracle_threads = std::max<size_t>(1, std::thread::hardware_concurrency() / workers);
+    auto worker = [&](){
+        // Tests already run on every core: the ideal flows and certificates of a test are computed by its worker only.
+#if defined(_OPENMP)
+        omp_set_num_threads(1);
+#endif
+        for (size_t k; (k = next++) < order.size(); ) {
+            auto start = std::chrono::steady_clock::now();
+            convergence[order[k]] = run_test<V>(tests[order[k]], *plotters[order[k]], warm, events, save_at, resume_at, params, oracle_threads);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::cerr << "test " << tests[order[k]] << " done in " << elapsed.count() << "s" << std::endl;
         }
-        std::cerr << "test " << test << "..." << std::flush;
-        // The name of files containing the network information.
-        const std::string file = "input/test" + file_number;
-        // The test network size
-        const int size = file_to_number(file + ".size");
-        // The ideal maximum flow.
-        std::vector<long long> flows = tests::get_flows("input/test" + file_number + ".txt", size);
-        // The network object type (interactive simulator with given options).
-        using net_t = component::batch_graph_simulator<option::list<true, true, false>>::net;
-        // The initialisation values (simulation name).
-        auto init_v = common::make_tagged_tuple<option::output, option::plotter, option::nodesinput, option::arcsinput, option::node_number, option::ideal_flow_history, option::test_id>(
-            nullptr,
-            &p,
-            file + ".nodes",
-            file + ".arcs",
-            size,
-            flows,
-            test
-        );
-        // Construct the network object.
-        net_t network{init_v};
-        // Run the simulation until exit.
-        network.run();
+    };
+    std::vector<std::thread> pool;
+    for (size_t i=0; i<workers; ++i) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+    return convergence;
+}
+
+//! @brief Runs all tests concurrently with a given variant of the algorithm, plotting their rows in test order to a file (or streaming them to a file if given).
+template <typename V>
+void run_tests(std::string const& plot_name, bool warm, std::string const& stream, std::string const& events, real_t save_at, real_t resume_at, option::parameters const& params) {
+    std::vector<int> tests;
+    for (int test=1; test<=22; ++test)
+        if (test != 16) tests.push_back(test);
+    std::vector<std::vector<real_t>> convergence;
+    if (stream.empty()) {
+        std::vector<option::plot_buffer<option::plot_t<V>, option::stream_row<V>>> buffers(tests.size());
+        std::vector<option::plot_buffer<option::plot_t<V>, option::stream_row<V>>*> plotters;
+        for (auto& b : buffers) plotters.push_back(&b);
+        convergence = run_concurrently<V>(tests, plotters, warm, events, save_at, resume_at, params);
+        // Merge rows in test order, for plots independent of scheduling.
+        trace_span span("plot");
+        option::plot_t<V> p;
+        for (auto const& b : buffers) b.replay(p);
+        std::cout << plot::file(plot_name, p.build());
+    } else {
+        // Rows of all tests are written to the same file as they are logged.
+        option::row_stream<option::stream_row<V>> rows(stream, stream.size() > 4 and stream.substr(stream.size() - 4) == ".bin");
+        std::vector<option::row_stream<option::stream_row<V>>*> plotters(tests.size(), &rows);
+        convergence = run_concurrently<V>(tests, plotters, warm, events, save_at, resume_at, params);
+        if (not rows) std::cerr << "error writing rows to " << stream << std::endl;
+        else std::cerr << "rows written to " << stream << ", plot them with: ./make.sh run -O replot - " << stream << std::endl;
+    }
+    if constexpr (V::early_stop) {
+        // The convergence times of every test are also plotted against the test, for every state of the network.
+        option::test_convergence_plot c;
+        for (size_t i=0; i<tests.size(); ++i) {
+            std::cerr << "test " << tests[i] << " convergence times:";
+            for (size_t j=0; j<convergence[i].size(); ++j) {
+                std::cerr << " " << convergence[i][j];
+                c << common::make_tagged_tuple<option::network_state, option::test_id, option::convergence_time>(int(j), tests[i], convergence[i][j]);
+            }
+            std::cerr << std::endl;
+        }
+        std::cout << plot::file(plot_name + "_convergence", c.build());
+    }
+}
+
+//! @brief Runs all tests with a given variant of the algorithm, with or without early stop.
+template <typename V>
+void run_tests(std::string const& plot_name, bool early, bool warm, std::string const& stream, std::string const& events, real_t save_at, real_t resume_at, option::parameters const& params) {
+    if (early) run_tests<variants::early_stop<V>>(plot_name, warm, stream, events, save_at, resume_at, params);
+    else run_tests<V>(plot_name, warm, stream, events, save_at, resume_at, params);
+}
+
+//! @brief The main function (pass "adaptive" to slow down rounds of quiescent nodes, "global" to periodically lift heights to the residual distance from sinks, "multi_push" to spread excess over all lower neighbours, "fused" to compute rounds with the fused kernel or "fused_checked" to also check it against the reference one, "counters" to count the events of each mechanism of the algorithm, "messages" to estimate the size of exports in a compact encoding, and "early" to skip rounds once every node is quiescent or "warm" to start from the reference solution of the first phase, with "trace" or "trace_bin" to also write an execution trace, "stream" or "stream_bin" to write rows to a file as they are logged instead of plotting them at the end, "scenario=<file>" to apply the events of a file instead of the default phases, "checkpoint=<time>" to save the state of every node at a time or "resume=<time>" to resume from it, and "config=<file>" or "<parameter>=<value>" to set simulation parameters).
+int main(int argc, char *argv[]) {
+    std::string name;
+    bool early = false, warm = false;
+    std::string trace, stream, events;
+    real_t save_at = -1, resume_at = -1;
+    option::parameters params;
+    for (int i=1; i<argc; ++i) {
+        if (std::string(argv[i]) == "early") early = true;
+        else if (std::string(argv[i]) == "warm") warm = true;
+        else if (std::string(argv[i]) == "trace" or std::string(argv[i]) == "trace_bin") trace = argv[i];
+        else if (std::string(argv[i]) == "stream" or std::string(argv[i]) == "stream_bin") stream = argv[i];
+        else if (std::string(argv[i]).compare(0, 9, "scenario=") == 0) events = std::string(argv[i]).substr(9);
+        else if (std::string(argv[i]).compare(0, 11, "checkpoint=") == 0) save_at = std::stod(std::string(argv[i]).substr(11));
+        else if (std::string(argv[i]).compare(0, 7, "resume=") == 0) resume_at = std::stod(std::string(argv[i]).substr(7));
+        else if (std::string(argv[i]).compare(0, 7, "config=") == 0) {
+            if (not params.read(std::string(argv[i]).substr(7))) {
+                std::cerr << "cannot read valid parameters from " << argv[i] + 7 << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]).find('=') != std::string::npos) {
+            if (not params.set(argv[i])) {
+                std::cerr << "invalid parameter " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else name = argv[i];
     }
-    std::cerr << std::endl;
-    // Print plots.
-    std::cout << plot::file("batch", p.build());
+    if (not trace.empty()) tracer::instance().enable();
+    std::string plot_name = name.empty() ? "batch" : "batch_" + name;
+    if (early) plot_name += "_early";
+    if (warm) plot_name += "_warm";
+    if (not events.empty()) plot_name += "_scenario";
+    if (resume_at >= 0) plot_name += "_resumed";
+    plot_name += params.suffix();
+    if (not sync_rounds) plot_name += "_async";
+    std::string rows_file;
+    if (stream == "stream") rows_file = plot_name + ".rows.csv";
+    if (stream == "stream_bin") rows_file = plot_name + ".rows.bin";
+
+    // Run the tests, plotting their rows (or streaming them to a file, to be plotted offline).
+    if (name == "adaptive") run_tests<variants::adaptive>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "global") run_tests<variants::global_relabel>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "multi_push") run_tests<variants::multi_push>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "fused") run_tests<variants::fused>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "fused_checked") run_tests<variants::fused_checked>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "counters") run_tests<variants::counters>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else if (name == "messages") run_tests<variants::messages>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    else run_tests<variants::standard>(plot_name, early, warm, rows_file, events, save_at, resume_at, params);
+    // Write the execution trace (Chrome trace-event JSON, or binary), and summarise it.
+    if (trace == "trace") tracer::instance().write_chrome(plot_name + ".trace.json");
+    if (trace == "trace_bin") tracer::instance().write_binary(plot_name + ".trace.bin");
+    if (not trace.empty()) tracer::instance().summary(std::cerr);
     return 0;
 }
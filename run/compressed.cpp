@@ -0,0 +1,48 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../lib/openmp.hpp"
+#include "../lib/compressed.hpp"
+
+// Compares memory footprint and solving time of the pointer-based graph and of the compressed
+// topology on every phase of every input, checking that they find the same flows.
+int main() {
+	int failures = 0;
+	for (int test = 1; test <= 22; ++test) {
+		string file = "input/test" + to_string(test);
+		int size;
+		std::ifstream(file + ".size") >> size;
+
+		vector<tuple<int, int, long long>> arcs = read_arcs<long long>(file + ".txt");
+		vector<pair<vector<int>, vector<int>>> phases = tests::get_phases(size);
+
+		std::unordered_map<int, node*> node_map;
+		graph g = tests::get_graph_from_file(file + ".txt", node_map);
+		double graph_bytes = g.memory() * 1.0 / arcs.size();
+
+		auto start = chrono::high_resolution_clock::now();
+		vector<long long> expected = tests::get_flows(file + ".txt", size);
+		auto stop = chrono::high_resolution_clock::now();
+		auto graph_time = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+		double compressed_bytes = 0;
+		start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < phases.size(); i++) {
+			compressed_graph<> c(make_topology(arcs, phases[i].first, phases[i].second));
+			compressed_bytes = c.memory() * 1.0 / arcs.size();
+			long long flow = c.get_max_flow();
+			if (flow != expected[i]) {
+				std::cout << "TEST " << test << " phase " << i << " FAILED: " << flow << " instead of " << expected[i] << "\n";
+				failures++;
+			}
+		}
+		stop = chrono::high_resolution_clock::now();
+		auto compressed_time = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+		std::cout << "TEST " << test << " - bytes per input arc: " << graph_bytes << " (graph) vs " << compressed_bytes << " (compressed)"
+		          << " - time: " << graph_time.count() << "us (graph) vs " << compressed_time.count() << "us (compressed)\n";
+	}
+	std::cout << (failures == 0 ? "ALL TESTS OK\n" : "SOME TESTS FAILED\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <string>
+
+#include "../lib/topology.hpp"
+
+// Converts the capacities of inputs to binary CSR (.csr) files, together with node files (.ids)
+// listing device ids only, for the fast loading path of the batch simulation.
+int main(int argc, char* argv[]) {
+	vector<int> tests;
+	for (int i = 1; i < argc; ++i) {
+		tests.push_back(stoi(argv[i]));
+	}
+	if (tests.empty()) {
+		for (int test = 1; test <= 22; ++test) {
+			tests.push_back(test);
+		}
+	}
+	int failures = 0;
+	for (int test : tests) {
+		string file = "input/test" + to_string(test);
+		int size;
+		std::ifstream(file + ".size") >> size;
+
+		device_capacities<long long> d = make_device_capacities(read_arcs<long long>(file + ".txt"), size);
+		std::ofstream ids(file + ".ids");
+		for (int u = 1; u <= size; ++u) {
+			ids << u << "\t{*: 0}\n";
+		}
+		if (!write_csr(file + ".csr", d) || !ids) {
+			std::cout << "TEST " << test << " FAILED\n";
+			failures++;
+			continue;
+		}
+		std::cout << "TEST " << test << " - " << d.size() << " devices, " << d.head.size() << " arcs\n";
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../lib/openmp.hpp"
+#include "../lib/distributed.hpp"
+
+// Solves every phase of every input with the partitioned solver, and checks the result
+// against the shared-memory solver.
+// Usage: distributed [processes] [shm|socket]
+template <typename transport>
+int run_tests(int processes) {
+	int failures = 0;
+	for (int test = 1; test <= 22; ++test) {
+		string file = "input/test" + to_string(test);
+		int size;
+		std::ifstream(file + ".size") >> size;
+
+		vector<long long> expected = tests::get_flows(file + ".txt", size);
+		vector<tuple<int, int, long long>> arcs = read_arcs<long long>(file + ".txt");
+		vector<pair<vector<int>, vector<int>>> phases = tests::get_phases(size);
+
+		auto start = chrono::high_resolution_clock::now();
+		size_t bytes = 0;
+		int rounds = 0;
+		for (size_t i = 0; i < phases.size(); i++) {
+			topology<long long> t = make_topology(arcs, phases[i].first, phases[i].second);
+			distributed::partitioned_graph<transport> g(t, distributed::block_partition(t.size(), processes), processes);
+			long long flow = g.get_max_flow();
+			bytes += g.bytes_sent;
+			rounds += g.rounds;
+			if (g.failed) {
+				std::cout << "TEST " << test << " phase " << i << " FAILED: a process terminated abnormally\n";
+				failures++;
+			}
+			else if (flow != expected[i]) {
+				std::cout << "TEST " << test << " phase " << i << " FAILED: " << flow << " instead of " << expected[i] << "\n";
+				failures++;
+			}
+		}
+		auto stop = chrono::high_resolution_clock::now();
+		auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
+		std::cout << "TEST " << test << " - rounds: " << rounds << " - bytes sent by process 0: " << bytes << " - time: " << duration.count() << "us\n";
+	}
+	return failures;
+}
+
+int main(int argc, char* argv[]) {
+	int processes = argc > 1 ? stoi(argv[1]) : 4;
+	string backend = argc > 2 ? argv[2] : "shm";
+
+	int failures = backend == "socket" ? run_tests<distributed::socket_transport>(processes) : run_tests<distributed::shm_transport>(processes);
+	std::cout << (failures == 0 ? "ALL TESTS OK\n" : "SOME TESTS FAILED\n");
+	return failures == 0 ? 0 : 1;
+}
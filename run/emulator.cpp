@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "../lib/openmp.hpp"
+#include "../lib/scenario.hpp"
+#include "../lib/emulator.hpp"
+#include "../lib/parameters.hpp"
+
+// Reads the sink flows logged by a batch run streamed to a CSV file (time, test and total sink flow
+// leading every row), by test and time.
+map<int, map<int, long long>> read_sink_flows(string file_name) {
+	map<int, map<int, long long>> flows;
+	std::ifstream file(file_name);
+	string line;
+	getline(file, line);
+	while (getline(file, line)) {
+		replace(line.begin(), line.end(), ',', ' ');
+		std::stringstream s(line);
+		double time;
+		int test;
+		long long flow;
+		if (s >> time >> test >> flow) {
+			flows[test][static_cast<int>(time)] = flow;
+		}
+	}
+	return flows;
+}
+
+// Usage: emulator [<test>...] [multi_push] [rows=<file>] [config=<file>] [<parameter>=<value>...]
+int usage(string const& arg) {
+	std::cerr << "invalid argument " << arg << "\nusage: emulator [<test>...] [multi_push] [rows=<file>] [config=<file>] [<parameter>=<value>...]" << std::endl;
+	return 1;
+}
+
+// Runs the bulk-synchronous emulation of the aggregate algorithm on the given inputs (all by default),
+// printing its time, the flow reached in every phase against the ideal one and the rounds it took. With "multi_push", excess
+// is spread over all lower neighbours. Simulation parameters are set as in batch runs ("config=<file>"
+// or "<parameter>=<value>"), but only rounds of period 1 can be emulated (always synchronous). With a file of rows
+// streamed by the batch simulation of the same variant and parameters ("rows=<file>"), the total sink
+// flow of every logged time is compared with the emulated one.
+int main(int argc, char* argv[]) {
+	bool multi_push = false;
+	string rows;
+	parameters params;
+	vector<int> inputs;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "multi_push") {
+			multi_push = true;
+		}
+		else if (arg.compare(0, 5, "rows=") == 0) {
+			rows = arg.substr(5);
+		}
+		else if (arg.compare(0, 7, "config=") == 0) {
+			if (!params.read(arg.substr(7))) {
+				std::cerr << "cannot read valid parameters from " << arg.substr(7) << std::endl;
+				return 1;
+			}
+		}
+		else if (arg.find('=') != string::npos) {
+			if (!params.set(arg)) {
+				return usage(arg);
+			}
+		}
+		else {
+			std::istringstream in(arg);
+			int test;
+			char rest;
+			if (!(in >> test) || in >> rest || test < 1) {
+				return usage(arg);
+			}
+			inputs.push_back(test);
+		}
+	}
+	if (params.round_period != 1) {
+		std::cerr << "only rounds of period 1 can be emulated (round_period=1)" << std::endl;
+		return 1;
+	}
+	if (inputs.empty()) {
+		for (int test = 1; test <= 22; ++test) {
+			if (test != 16) {
+				inputs.push_back(test);
+			}
+		}
+	}
+	map<int, map<int, long long>> logged;
+	if (!rows.empty()) {
+		logged = read_sink_flows(rows);
+	}
+
+	int failures = 0;
+	for (int test : inputs) {
+		string file = "input/test" + to_string(test);
+		int size;
+		if (!(std::ifstream(file + ".size") >> size)) {
+			std::cout << "TEST " << test << " FAILED: cannot read " << file << ".size\n";
+			failures++;
+			continue;
+		}
+		vector<tuple<int, int, long long>> arcs = read_arcs<long long>(file + ".txt");
+		scenario s = make_scenario(phase_events(size, params.phase_time), arcs);
+		vector<long long> expected = tests::get_flows(file + ".txt", size);
+
+		auto start = chrono::high_resolution_clock::now();
+		bulk_emulator e(arcs, size, multi_push);
+		vector<long long> sink_flow = e.run(s, params.last());
+		auto stop = chrono::high_resolution_clock::now();
+		auto time = chrono::duration_cast<chrono::microseconds>(stop - start);
+
+		std::cout << "TEST " << test << " - " << sink_flow.size() << " rounds of " << size << " devices in " << time.count() << "us - flows:";
+		// the flow of the last round of every phase reached, and the rounds after which it stayed ideal
+		vector<string> convergence;
+		for (int i = 0; i < default_phase_number && i * params.phase_time < sink_flow.size(); i++) {
+			size_t first = ceil(i * params.phase_time - 0.5);
+			size_t last = min(sink_flow.size(), max<size_t>(1, ceil((i + 1) * params.phase_time - 0.5)));
+			std::cout << " " << sink_flow[last - 1] << "/" << expected[i];
+			size_t converged = first;
+			for (size_t k = first; k < last; k++) {
+				if (sink_flow[k] != expected[i]) {
+					converged = k + 1;
+				}
+			}
+			convergence.push_back(converged < last ? to_string(converged - first) : "none");
+		}
+		std::cout << " - convergence rounds:";
+		for (string const& c : convergence) {
+			std::cout << " " << c;
+		}
+		std::cout << "\n";
+
+		// the row logged at time t follows the round at time t - 1/2
+		if (!rows.empty()) {
+			int mismatches = 0, checked = 0;
+			for (auto const& x : logged[test]) {
+				if (x.first < 1 || x.first > static_cast<int>(sink_flow.size())) {
+					continue;
+				}
+				checked++;
+				if (sink_flow[x.first - 1] != x.second) {
+					if (mismatches == 0) {
+						std::cout << "TEST " << test << " FAILED: sink flow " << sink_flow[x.first - 1] << " instead of " << x.second << " at time " << x.first << "\n";
+					}
+					mismatches++;
+				}
+			}
+			if (checked == 0) {
+				std::cout << "TEST " << test << " not found in " << rows << "\n";
+			}
+			failures += mismatches > 0 || checked == 0;
+		}
+	}
+	if (!rows.empty()) {
+		std::cout << (failures == 0 ? "ALL TESTS OK\n" : "SOME TESTS FAILED\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
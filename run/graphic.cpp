@@ -9,14 +9,43 @@
 #include "lib/openmp.hpp"
 #include "lib/aggregate.hpp"
 
-//! @brief The main function.
+//! @brief Runs an interactive network with given options and initialisation values until exit.
+template <typename O, typename I>
+void run_network(I const& init_v) {
+    // Construct the network object.
+    typename fcpp::component::interactive_graph_simulator<O>::net network{init_v};
+    // Run the simulation until exit.
+    network.run();
+}
+
+//! @brief The main function (with the test to be run, then "trace" or "trace_bin" to also write an execution trace, and "config=<file>" or "<parameter>=<value>" to set simulation parameters).
 int main(int argc, char *argv[]) {
     using namespace fcpp;
     // The test to be run
     int test = argc > 1 ? stoi(argv[1]) : 4;
+    std::string trace;
+    option::parameters params;
+    for (int i=2; i<argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "trace" or arg == "trace_bin") trace = arg;
+        else if (arg.compare(0, 7, "config=") == 0) {
+            if (not params.read(arg.substr(7))) {
+                std::cerr << "cannot read valid parameters from " << arg.substr(7) << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.find('=') != std::string::npos) {
+            if (not params.set(arg)) {
+                std::cerr << "invalid parameter " << arg << std::endl;
+                return 1;
+            }
+        }
+        else std::cerr << "unknown argument " << arg << std::endl;
+    }
+    if (not trace.empty()) tracer::instance().enable();
 
     // Set up the plotting object.
-    fcpp::option::plot_t p;
+    fcpp::option::plot_t<> p;
     std::cout << "/*\n";
     {
         // The name of files containing the network information.
@@ -25,25 +54,35 @@ int main(int argc, char *argv[]) {
         const int size = file_to_number(file + ".size");
         // The ideal maximum flow.
         std::vector<long long> flows = tests::get_flows("input/test" + std::to_string(test) + ".txt", size);
-        // The network object type (interactive simulator with given options).
-        using net_t = component::interactive_graph_simulator<option::list<true, true, true>>::net;
+        // The states of the network over time (the default phases).
+        auto states = std::make_shared<const scenario>(make_scenario(phase_events(size, params.phase_time), read_arcs<long long>(file + ".txt")));
         // The initialisation values (simulation name).
-        auto init_v = common::make_tagged_tuple<option::name, option::plotter, option::nodesinput, option::arcsinput, option::node_number, option::ideal_flow_history, option::test_id>(
+        auto init_v = common::make_tagged_tuple<option::name, option::plotter, option::nodesinput, option::arcsinput, option::node_number, option::ideal_flow_history, option::network_scenario, option::end_time, option::round_period, option::round_deviation, option::area_side, option::test_id>(
             "Aggregate Push-Relabel",
             &p,
             file + ".nodes",
             file + ".arcs",
             size,
             flows,
+            states,
+            times_t(params.last()),
+            times_t(params.round_period),
+            times_t(params.round_deviation),
+            params.area_side,
             test
         );
-        // Construct the network object.
-        net_t network{init_v};
-        // Run the simulation until exit.
-        network.run();
+        // Run the interactive simulation with the given options.
+        run_network<option::list<true, sync_rounds, true>>(init_v);
     }
     // Print plots.
     std::cout << "*/\n";
-    std::cout << plot::file("graphic", p.build());
+    {
+        trace_span span("plot");
+        std::cout << plot::file("graphic", p.build());
+    }
+    // Write the execution trace (Chrome trace-event JSON, or binary), and summarise it.
+    if (trace == "trace") tracer::instance().write_chrome("graphic.trace.json");
+    if (trace == "trace_bin") tracer::instance().write_binary("graphic.trace.bin");
+    if (not trace.empty()) tracer::instance().summary(std::cerr);
     return 0;
 }
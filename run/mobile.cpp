@@ -0,0 +1,157 @@
+// Copyright © 2024 Giorgio Audrito and Stefano Manescotto. All Rights Reserved.
+
+/**
+ * @file mobile.cpp
+ * @brief Large-scale test of the Aggregate Push-Relabel algorithm on mobile devices, against the maximum flow of every snapshot.
+ */
+
+#include <memory>
+
+#include "lib/fcpp.hpp"
+#include "lib/mobile.hpp"
+#include "lib/oracle.hpp"
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+//! @brief Number of devices.
+constexpr int device_num = 2000;
+//! @brief Side of the square area where devices move.
+constexpr int area_side = 4000;
+//! @brief Maximum speed of devices.
+constexpr int max_speed = 10;
+//! @brief The end of simulated time.
+constexpr size_t end_time = 300;
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+//! @brief Tags used in the node and network storage.
+namespace tags {
+    //! @brief Flow reaching the sink.
+    struct sink_flow {};
+    //! @brief Maximum flow of the network snapshot.
+    struct ideal_flow {};
+    //! @brief Relative error of the flow reaching the sink.
+    struct flow_error {};
+    //! @brief The oracle computing maximum flows of network snapshots.
+    struct snapshot_oracle_ref {};
+}
+
+//! @brief Main function.
+MAIN() {
+    // import tag names in the local scope.
+    using namespace tags;
+
+    rectangle_walk(CALL, make_vec(0, 0), make_vec(area_side, area_side), max_speed, 1);
+
+    field<bool> connected = nbr(CALL, false, true);
+    field<double> capacity = link_capacities(CALL, connected);
+
+    bool is_source = node.uid == 0;
+    bool is_sink = node.uid == device_num-1;
+
+    tuple<double, int> result = aggregate_push_relabel(CALL, is_source, is_sink, capacity, device_num);
+    node.storage(sink_flow{}) = is_sink ? get<0>(result) : 0;
+
+    // hand the position of the device (and the flow reaching the sink) to the oracle, once per step
+    auto const& pos = node.position();
+    node.net.storage(snapshot_oracle_ref{})->report(int(node.current_time()), node.uid, pos[0], pos[1], node.storage(sink_flow{}));
+}
+
+//! @brief Export types used by the main function (update it when expanding the program).
+FUN_EXPORT main_t = export_list<aggregate_push_relabel_t, link_capacities_t, bool, vec<2>>;
+
+} // namespace coordination
+
+//! @brief Namespace for component options.
+namespace option {
+
+//! @brief Import tags to be used for component options.
+using namespace component::tags;
+//! @brief Import tags used by aggregate functions.
+using namespace coordination::tags;
+
+//! @brief Dimensionality of the space.
+constexpr size_t dim = 2;
+
+//! @brief One round every simulated second (at its half, so that every round falls in a distinct step).
+using round_s = sequence::periodic_n<2, 1, 2, 2*end_time>;
+//! @brief The sequence of node generation events (device_num devices all generated at time 0).
+using spawn_s = sequence::multiple_n<device_num, 0>;
+//! @brief The distribution of initial node positions (random in the area).
+using rectangle_d = distribution::rect_n<1, 0, 0, area_side, area_side>;
+
+//! @brief Helper template for plotting multiple lines.
+template <typename... Ts>
+using lines_t = plot::join<plot::value<Ts>...>;
+
+//! @brief Overall plot description: flow reaching the sink against the maximum flow, and their relative error.
+using plot_t = plot::join<plot::split<plot::time, lines_t<sink_flow, ideal_flow>>, plot::split<plot::time, lines_t<flow_error>>>;
+
+//! @brief The general simulation options.
+DECLARE_OPTIONS(list,
+    parallel<true>,      // multithreading enabled on node rounds
+    synchronised<true>,  // optimise for synchronous networks
+    program<coordination::main>,   // program to be run (refers to MAIN above)
+    exports<coordination::main_t>, // export type list (types used in messages)
+    retain<metric::retain<2, 1>>,  // messages are kept for 2 seconds before expiring
+    round_schedule<round_s>, // the sequence generator for round events on nodes
+    spawn_schedule<spawn_s>, // the sequence generator of node creation events on the network
+    net_store<               // overall parameters stored at the network level
+        snapshot_oracle_ref, std::shared_ptr<snapshot_oracle>
+    >,
+    tuple_store<             // the contents of the node storage
+        sink_flow,  double
+    >,
+    init<
+        x,      rectangle_d // initialise position randomly in a rectangle for new nodes
+    >,
+    dimension<dim>, // dimensionality of the space
+    area<0, 0, area_side, area_side>,
+    connector<connect::fixed<radius, 1, dim>> // connection allowed within a fixed comm range
+);
+
+} // namespace option
+
+} // namespace fcpp
+
+//! @brief The main function.
+int main() {
+    using namespace fcpp;
+
+    // The oracle, solving the unit-disk graph of every step with the capacity table of devices (which
+    // only differ by keeping the capacity of a link until its length moves by capacity_tolerance).
+    auto oracle = std::make_shared<snapshot_oracle>(device_num, radius, [](double d){
+        return coordination::relative_capacity_table()(d);
+    }, 0, device_num-1);
+    {
+        //! @brief The network object type (batch simulator with given options).
+        using net_t = component::batch_simulator<option::list>::net;
+        //! @brief The initialisation values.
+        auto init_v = common::make_tagged_tuple<option::output, option::snapshot_oracle_ref, option::seed>(nullptr, oracle, 42);
+        //! @brief Construct the network object.
+        net_t network{init_v};
+        //! @brief Run the simulation until exit.
+        network.run();
+    }
+    // Rows of the error curve, from the snapshots solved (waiting for the ones still queued).
+    option::plot_t p;
+    double total_error = 0;
+    std::vector<std::tuple<int, double, double>> results = oracle->results();
+    for (auto const& r : results) {
+        double error = get<2>(r) > 0 ? std::abs(get<2>(r) - get<1>(r)) / get<2>(r) : 0;
+        total_error += error;
+        p << common::make_tagged_tuple<plot::time, coordination::tags::sink_flow, coordination::tags::ideal_flow, coordination::tags::flow_error>(get<0>(r), get<1>(r), get<2>(r), error);
+    }
+    std::cerr << results.size() << " snapshots solved, mean relative error " << (results.empty() ? 0 : total_error / results.size()) << std::endl;
+    std::vector<std::pair<int, int>> dropped = oracle->dropped();
+    if (not dropped.empty()) {
+        std::cerr << dropped.size() << " steps dropped as not every device reported (step/reports):";
+        for (auto const& d : dropped) std::cerr << " " << d.first << "/" << d.second;
+        std::cerr << std::endl;
+    }
+    std::cout << plot::file("mobile", p.build());
+    return 0;
+}
@@ -0,0 +1,39 @@
+// Copyright © 2024 Giorgio Audrito and Stefano Manescotto. All Rights Reserved.
+
+/**
+ * @file replot.cpp
+ * @brief Offline plotting of rows streamed by a batch test of the Aggregate Push-Relabel algorithm.
+ */
+
+#include "lib/fcpp.hpp"
+#include "lib/openmp.hpp"
+#include "lib/aggregate.hpp"
+
+using namespace fcpp;
+
+//! @brief Plots the rows of a file, streamed by a batch test of a given variant of the algorithm.
+template <typename V>
+void replot(std::string const& file) {
+    option::plot_t<V> p;
+    size_t rejected;
+    size_t rows = option::read_rows<V>(file, p, rejected);
+    std::cerr << file << ": " << rows << " rows" << std::endl;
+    if (rejected > 0) std::cerr << file << ": " << rejected << " rows rejected as unparsable or truncated" << std::endl;
+    // The plot name is the file name without the rows extension.
+    std::string plot_name = file.substr(0, file.rfind(".rows"));
+    std::cout << plot::file(plot_name, p.build());
+}
+
+//! @brief The main function (pass the files of rows to be plotted, each producing the plots it was streamed instead of).
+int main(int argc, char *argv[]) {
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty()) files.push_back("batch.rows.csv");
+    for (std::string const& file : files) {
+        // The columns logged depend on the variant streaming them.
+        size_t columns = option::file_columns(file);
+        if (columns == option::row_columns(option::stream_row<variants::messages>{})) replot<variants::messages>(file);
+        else if (columns == option::row_columns(option::stream_row<variants::counters>{})) replot<variants::counters>(file);
+        else replot<variants::standard>(file);
+    }
+    return 0;
+}
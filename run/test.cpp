@@ -11,19 +11,13 @@
 #include <list>
 #include "lib/deployment/hardware_identifier.hpp"
 #include <cmath>
+#include "lib/mobile.hpp"
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
  */
 namespace fcpp {
 
-//! @brief Dummy ordering between positions (allows positions to be used as secondary keys in ordered tuples).
-template <size_t n>
-bool operator<(vec<n> const&, vec<n> const&) {
-    return false;
-}
-
-constexpr int fail_probability = 90;
 //! @brief Number of people in the area.
 constexpr int node_num = 3;
 
@@ -52,123 +46,15 @@ namespace tags {
 }
 
 namespace coordination {
-//! @brief The maximum communication range between nodes.
-constexpr size_t communication_range = 1;
-
-FUN tuple<double, int> aggregate_push_relabel(ARGS, bool is_source, bool is_sink, field<double> capacity, int node_num) { CODE
-    double e_flow = 0;
-    int height = 0;
-    tuple<field<double>, int, int> init(0, 0, 0);
-    
-    nbr(CALL, init, [&](field<tuple<double, int, int>> flow_height){
-        field<double> new_flow = 0;
-
-        field<double> flow = -get<0>(flow_height);
-        field<int> nbr_height = get<1>(flow_height);
-        field<int> nbr_priority = get<2>(flow_height);
-
-        height = get<1>(self(CALL, flow_height));
-        field<bool> neigh_is_source = nbr(CALL, is_source);
-        
-        tuple<field<double>, field<int>> o_flow(flow, nbr_priority);
-
-        o_flow = old(CALL, o_flow, [&](field<tuple<double, int>> old_values){
-            field<double> old_flow = get<0>(old_values);
-            field<int> old_priority = get<1>(old_values);
-
-            field<tuple<double, int>> temp = map_hood([&](double f, double of, int priority, int h, int op, int uids){
-                if(priority == op and op == 2 and f != of){
-                    if(node.uid < uids){
-                        return make_tuple(of, 2);
-                    }
-                    return make_tuple(f, 2);
-                }
-
-                if(f != of and height + 1 != h and priority == 1){
-                    return make_tuple(of, 2);
-                } else{
-                    return make_tuple(f, 0);
-                }
-            }, flow, old_flow, nbr_priority, nbr_height, old_priority, nbr_uid(CALL));
-
-            flow = get<0>(temp);
-            nbr_priority = get<1>(temp);
-
-            if (is_sink) {
-                height = 0;
-                flow = mux(flow > 0, .0, flow);
-            }
-            if (is_source) {
-                height = node_num;
-                flow = mux(nbr_height < height, capacity, mux(flow < 0, .0, flow));
-            }
-
-            flow = mux(flow > capacity, capacity, flow);
-            e_flow = -sum_hood(CALL, flow, 0);
-
-            // if a node is giving away more flow than it receives, stop giving excess (variant to try: reduce outgoing edges proportionally)
-            if (not is_source and e_flow < 0) {
-                flow = map_hood([&](double f, int priority){
-                    if (f > 0) {
-                        long long r = min(-e_flow, f);
-                        f -= r;
-                        e_flow -= r;
-                    }
-                    return f;
-                }, flow, nbr_priority);
-            }
-            
-            field<double> res_capacity = capacity - flow;
-
-            field<int> neighs = nbr_uid(CALL);
-            tuple<int, int> min_height = min_hood(CALL, mux(res_capacity > 0 and neighs != node.uid, make_tuple(nbr_height, neighs), make_tuple(INT_MAX, INT_MAX)));
-
-            if (get<0>(min_height) >= height and e_flow > 0 and not is_source and not is_sink) {
-                assert(min_height != make_tuple(INT_MAX, INT_MAX));
-                height = get<0>(min_height) + 1; // Relabel
-            }
-            
-            if (not is_source and not is_sink and e_flow > 0){
-                new_flow = mux(get<1>(min_height) == neighs and height >= get<0>(min_height) + 1, min(res_capacity, e_flow), (double)0);
-                nbr_priority = mux(new_flow > 0, 1, nbr_priority);
-            }
-
-            height = min_hood(CALL, mux(res_capacity > 0 and nbr_height + 1 < height, nbr_height, height));
-            return make_tuple(flow + new_flow, nbr_priority);
-        });
-        flow = get<0>(o_flow);
-        return make_tuple(flow, height, nbr_priority);
-    });
-    
-    return make_tuple(e_flow, height);
-}
-
 
 //! @brief Main function.
-//using position_type = vec<fcpp::component::tags::dimension>;
-double get_capacity(double distance){
-    double e = (double)pow((7*exp(((fail_probability/100) - (250/distance) * log(6792093/29701))/(1-(fail_probability/100)) + 1)), (double)-1/3);
-    return e;
-}
-
 MAIN() {
     // import tag names in the local scope.
     using namespace tags;
 	int uid = node.uid;
 
-    //    field<double> capacity = node.nbr_dist();
-    field<double> capacity = 1;
     field<bool> connected = nbr(CALL, false, true);
-
-    // capacity = mux(capacity > 0 and capacity <= 250 and connected, 260 - capacity, 0ll);
-    capacity = map_hood([&](int dist, bool conn){
-        if(conn){
-            //double c = get_capacity(dist);
-            double c = dist;
-            return c;
-        }
-        return .0;
-    }, capacity, connected);
+    field<double> capacity = link_capacities(CALL, connected);
 
     vec<2> rec1 = vec<2>(), rec2 = vec<2>();
     *rec1.begin() = 0;
@@ -193,7 +79,7 @@ MAIN() {
 }
 
 //! @brief Export types used by the main function (update it when expanding the program).
-FUN_EXPORT main_t = export_list<tuple<field<double>, int, field<int>>, field<double>, bool, int, field<int>, tuple<field<double>, field<int>>, vec<2>>;
+FUN_EXPORT main_t = export_list<tuple<field<double>, int, field<int>>, field<double>, bool, int, field<int>, tuple<field<double>, field<int>>, vec<2>, link_capacities_t>;
 
 } // namespace coordination
 
@@ -211,10 +97,6 @@ using namespace coordination::tags;
 constexpr size_t dim = 2;
 constexpr size_t end = 1000;
 
-//! @brief Radius of communication.
-constexpr int radius = 250;
-
-// 
 
 //! @brief Description of the round schedule.
 template <bool sync>